@@ -13,6 +13,11 @@
 
 static const char *TAG = "W4RP";
 
+// Reply queue slots kept for stream control: ordinary replies leave two
+// free, STREAM_ACK / OTA:WIN one, DATA_LOST may take the last
+static const size_t REPLY_RESERVE = 2;
+static const size_t ACK_RESERVE = 1;
+
 namespace W4RP {
 
 Controller::Controller(CAN *canBus, Storage *storage, Communication *transport,
@@ -20,22 +25,19 @@ Controller::Controller(CAN *canBus, Storage *storage, Communication *transport,
     : canBus_(canBus), storage_(storage), transport_(transport),
       otaService_(otaService), engine_() {
 
-  // Set transport callbacks
+  // Transport callbacks run in the transport's task: only enqueue here,
+  // everything else happens in loop(). After a drop (full ring) the next
+  // packet is flagged, and processInbox() stops an open stream there.
   transport_->onReceive([this](const uint8_t *data, size_t len) {
-    if (streamType_ != NONE) {
-      handleStreamData(data, len);
-    } else {
-      handleCommand(data, len);
-    }
+    rxRing_.push(data, len);
   });
 
   transport_->onConnectionChange([this](bool connected) {
     if (!connected) {
-      // Reset stream state on disconnect
-      streamType_ = NONE;
-      streamBuffer_.clear();
-      engine_.setDebugMode(false);
-      engine_.clearDebugSignals();
+      // Ordered after packets already queued; flag covers a full ring
+      if (!rxRing_.push(nullptr, 0, W4RP_PACKET_DISCONNECT)) {
+        linkDropped_.store(true, std::memory_order_release);
+      }
     }
   });
 }
@@ -55,6 +57,7 @@ void Controller::setModuleInfo(const char *hw, const char *fw,
     moduleId_ = String(moduleId); // User-provided takes priority
   if (bleName)
     bleName_ = String(bleName); // Custom BLE advertising name
+  profileValid_ = false;
 }
 
 void Controller::setLedPin(int8_t pin) {
@@ -101,21 +104,29 @@ void Controller::begin() {
 }
 
 void Controller::loop() {
-  if (otaService_ && otaService_->needsPause()) {
-    otaService_->loop();
-    updateLed();
-    return;
-  }
+  uint32_t loopStartUs = micros();
 
+  // CAN first: rules keep running during OTA, flash work is in the
+  // OTA driver's low-priority tasks
   CanFrame frame;
   while (canBus_->receive(frame)) {
     engine_.processCanFrame(frame);
   }
 
   engine_.evaluateRules();
+  trackRuleLatency();
+
+  processInbox();
+  checkOtaStream();
+
+  if (txPhase_ != TX_IDLE) {
+    pumpTransfer();
+  } else {
+    flushReplies();
+  }
 
-  if (engine_.isDebugMode()) {
-    sendDebugUpdates();
+  if (txPhase_ == TX_IDLE && engine_.isDebugMode()) {
+    sendDebugUpdates(); // Never interleaved with a bulk transfer
   }
 
   uint32_t now = millis();
@@ -125,190 +136,557 @@ void Controller::loop() {
   }
 
   transport_->loop();
+  storage_->loop();
   updateLed();
 
   if (otaService_) {
     otaService_->loop();
+    finishOtaStats();
+  }
+
+  if (txStats_.active) {
+    uint32_t loopUs = micros() - loopStartUs;
+    if (loopUs > txStats_.maxLoopUs)
+      txStats_.maxLoopUs = loopUs;
   }
 }
 
-void Controller::registerCapability(const String &id,
+bool Controller::registerCapability(const String &id,
                                     CapabilityHandler handler) {
-  engine_.registerCapability(id, handler);
+  return engine_.registerCapability(id, handler);
 }
 
-void Controller::registerCapability(const String &id, CapabilityHandler handler,
+bool Controller::registerCapability(const String &id, CapabilityHandler handler,
                                     const CapabilityMeta &meta) {
-  engine_.registerCapability(id, handler, meta);
+  return engine_.registerCapability(id, handler, meta);
 }
 
 bool Controller::isConnected() const { return transport_->isConnected(); }
 
-void Controller::handleCommand(const uint8_t *data, size_t len) {
-  String packet((char *)data, len);
-  packet.trim();
+void Controller::processInbox() {
+  PacketRing<W4RP_RX_RING_SLOTS, W4RP_RX_SLOT_SIZE>::Packet pkt;
+
+  // Bounded: packets arriving while we drain wait for the next loop()
+  for (size_t n = 0; n < W4RP_RX_RING_SLOTS && rxRing_.front(pkt); n++) {
+    if (pkt.flags & W4RP_PACKET_AFTER_GAP)
+      handleInboxGap(); // Before this packet: it is not contiguous
+
+    bool fragment = rxContinuation_;
+    bool continued = (pkt.flags & W4RP_PACKET_CONTINUED) != 0;
+    bool streaming = streamType_ != NONE && !streamSuspended_;
+
+    // Backpressure: leave it queued, retry on the next loop()
+    if (streaming && !(pkt.flags & W4RP_PACKET_DISCONNECT) &&
+        !streamAccepts(pkt.data, pkt.len, fragment || continued))
+      break;
+
+    rxContinuation_ = continued;
+
+    if (pkt.flags & W4RP_PACKET_DISCONNECT) {
+      handleDisconnect();
+    } else if (gapSuspended_ &&
+               (fragment || continued || !isResume(pkt.data, pkt.len))) {
+      // Stream data the client sent before it saw DATA_LOST: never a
+      // command, whatever its first byte
+    } else if (streaming) {
+      // Processed in place - slot memory is the only copy
+      handleStreamData(pkt.data, pkt.len, fragment || continued);
+    } else if (!fragment && !continued) {
+      handleCommand(pkt.data, pkt.len);
+    }
+
+    rxRing_.pop();
+  }
 
-  Serial.printf("[%s] CMD: %s\n", TAG, packet.c_str());
+  if (linkDropped_.exchange(false, std::memory_order_acq_rel)) {
+    handleDisconnect();
+  }
 
-  // GET:PROFILE
-  if (packet == "GET:PROFILE") {
-    sendProfile();
-    return;
+  if (streamSuspended_ && millis() - suspendedAtMs_ >= resumeTimeoutMs_) {
+    Serial.printf("[%s] Stream %08X expired\n", TAG, streamSession_);
+    abortStream();
+  }
+
+  // Window reopened as the service drained: tell the client
+  if (streamType_ != NONE && !streamSuspended_) {
+    WBPStreamPosition pos = streamPosition();
+    uint32_t limit = pos.offset + pos.window;
+    if (limit > streamAckLimit_ &&
+        limit - streamAckLimit_ >= W4RP_STREAM_WINDOW_STEP)
+      ackStream();
   }
+}
+
+void Controller::trackRuleLatency() {
+  uint32_t now = micros();
+  if (otaStats_.active) {
+    uint32_t gap = now - lastRuleUs_;
+    if (gap > otaStats_.maxRuleLatencyUs)
+      otaStats_.maxRuleLatencyUs = gap;
+    otaStats_.evaluations++;
+  }
+  lastRuleUs_ = now;
+}
+
+void Controller::finishOtaStats() {
+  if (!otaStats_.active)
+    return;
 
-  // GET:RULES
-  if (packet == "GET:RULES") {
-    sendRules();
+  OTAStatus status = otaService_->getStatus();
+  if (status == OTAStatus::RECEIVING || status == OTAStatus::VALIDATING ||
+      status == OTAStatus::APPLYING)
     return;
+
+  otaStats_.active = false;
+  otaStats_.durationMs = millis() - otaStartMs_;
+  Serial.printf("[%s] OTA: worst rule latency %u us over %u passes\n", TAG,
+                otaStats_.maxRuleLatencyUs, otaStats_.evaluations);
+}
+
+WBPStreamPosition Controller::streamPosition() const {
+  size_t window;
+  if ((streamType_ == OTA_FULL || streamType_ == OTA_DELTA) && otaService_) {
+    window = otaService_->getWindow();
+  } else {
+    // RAM streams take everything that was announced
+    window = streamExpectedLen_ > streamOffset_
+                 ? streamExpectedLen_ - streamOffset_
+                 : 0;
+  }
+
+  // Unprocessed stream bytes wait in the inbox, so a client filling the
+  // window must never overflow it
+  size_t inbox = inboxWindow();
+  if (window > inbox)
+    window = inbox;
+
+  // Never advertise past the announced length
+  uint32_t left = streamExpectedLen_ > streamOffset_
+                      ? streamExpectedLen_ - streamOffset_
+                      : 0;
+  if (window > left)
+    window = left;
+
+  WBPStreamPosition pos = {streamSession_, streamOffset_, (uint32_t)window};
+  return pos;
+}
+
+size_t Controller::inboxWindow() const {
+  // One slot stays free for commands and the disconnect event
+  size_t mtu = transport_->getMTU();
+  if (mtu == 0)
+    mtu = 1;
+  size_t slotsPerPacket = (mtu + W4RP_RX_SLOT_SIZE - 1) / W4RP_RX_SLOT_SIZE;
+  return (W4RP_RX_RING_SLOTS - 1) / slotsPerPacket * mtu;
+}
+
+bool Controller::streamAccepts(const uint8_t *data, size_t len,
+                               bool fragment) const {
+  if ((streamType_ != OTA_FULL && streamType_ != OTA_DELTA) || !otaService_)
+    return true;
+
+  if (!fragment && len == 3 && memcmp(data, "END", 3) == 0)
+    return true;
+
+  // Anything the service rejects anyway (error state) must not stall
+  if (otaService_->getStatus() != OTAStatus::RECEIVING)
+    return true;
+
+  return otaService_->getWindow() >= len;
+}
+
+void Controller::openStream(const Command &cmd, StreamType type) {
+  streamType_ = type;
+  streamCmd_ = cmd;
+  streamExpectedLen_ = cmd.length;
+  streamExpectedCRC_ = cmd.crc;
+  streamBuffer_.clear();
+  streamSession_ = ((uint32_t)bootCount_ << 16) | ++sessionCounter_;
+  streamOffset_ = 0;
+  streamAckOffset_ = 0;
+  streamAckLimit_ = 0;
+  streamSuspended_ = false;
+  gapSuspended_ = false;
+}
+
+void Controller::abortStream() {
+  if ((streamType_ == OTA_FULL || streamType_ == OTA_DELTA) && otaService_) {
+    otaService_->abort();
   }
 
-  // DEBUG:START
-  if (packet == "DEBUG:START") {
-    engine_.setDebugMode(true);
+  streamType_ = NONE;
+  streamBuffer_.clear();
+  streamBuffer_.shrink_to_fit();
+  streamSuspended_ = false;
+  gapSuspended_ = false;
+}
+
+void Controller::checkOtaStream() {
+  if (!otaService_ || (streamType_ != OTA_FULL && streamType_ != OTA_DELTA))
     return;
+
+  OTAStatus status = otaService_->getStatus();
+  switch (status) {
+  case OTAStatus::IDLE:
+  case OTAStatus::RECEIVING:
+  case OTAStatus::VALIDATING:
+  case OTAStatus::APPLYING:
+  case OTAStatus::SUCCESS:
+    return;
+  default:
+    // e.g. patch built for another image - stop the upload now, not after it
+    replyOtaError(status);
+    break;
+  }
+
+  Serial.printf("[%s] OTA failed mid-stream (status %d)\n", TAG, (int)status);
+  abortStream();
+}
+
+void Controller::replyOtaError(OTAStatus status) {
+  switch (status) {
+  case OTAStatus::ERROR_SOURCE:
+    reply(streamCmd_, CommandStatus::SOURCE_MISMATCH, "OTA:ERROR:SOURCE");
+    break;
+  case OTAStatus::ERROR_SIGNATURE:
+    reply(streamCmd_, CommandStatus::BAD_SIGNATURE, "OTA:ERROR:SIGNATURE");
+    break;
+  default:
+    reply(streamCmd_, CommandStatus::FAILED, "OTA:ERROR");
+    break;
+  }
+}
+
+void Controller::ackStream() {
+  WBPStreamPosition pos = streamPosition();
+  bool queued = true;
+
+  if (streamCmd_.binary) {
+    Command ack = streamCmd_;
+    ack.op = CommandOp::STREAM_ACK;
+    queued = postReply(ack, CommandStatus::OK, nullptr, (const uint8_t *)&pos,
+                       sizeof(pos), ACK_RESERVE);
+  } else if (streamType_ == OTA_FULL || streamType_ == OTA_DELTA) {
+    // OTA:WIN:<offset>:<window> - text clients send up to offset + window
+    char msg[40];
+    snprintf(msg, sizeof(msg), "OTA:WIN:%u:%u", pos.offset, pos.window);
+    queued = postReply(streamCmd_, CommandStatus::OK, msg, nullptr, 0,
+                       ACK_RESERVE);
+  }
+
+  // Not queued: the next packet or window step acks again
+  if (queued) {
+    streamAckOffset_ = pos.offset;
+    streamAckLimit_ = pos.offset + pos.window;
+  }
+}
+
+bool Controller::suspendStream() {
+  // Binary streams keep partial state (RAM buffer / open OTA handle)
+  // for RESUME; everything else is reset
+  if (streamCmd_.binary && resumeTimeoutMs_ > 0) {
+    streamSuspended_ = true;
+    suspendedAtMs_ = millis();
+    Serial.printf("[%s] Stream %08X suspended at %u bytes\n", TAG,
+                  streamSession_, streamOffset_);
+    return true;
   }
 
-  // DEBUG:STOP
-  if (packet == "DEBUG:STOP") {
-    engine_.setDebugMode(false);
-    engine_.clearDebugSignals();
+  abortStream();
+  return false;
+}
+
+void Controller::handleInboxGap() {
+  if (streamType_ == NONE || streamSuspended_) {
+    Serial.printf("[%s] Inbox full, packet dropped\n", TAG);
     return;
   }
 
-  // DEBUG:WATCH:<len>:<crc>
-  if (packet.startsWith("DEBUG:WATCH:")) {
-    int colon1 = packet.indexOf(':', 12);
-    if (colon1 > 12) {
-      streamExpectedLen_ = packet.substring(12, colon1).toInt();
-      streamExpectedCRC_ =
-          strtoul(packet.substring(colon1 + 1).c_str(), nullptr, 10);
-      streamType_ = DEBUG_WATCH;
-      streamBuffer_.clear();
-      streamBuffer_.reserve(streamExpectedLen_);
+  // Packets after the gap would be appended at the wrong offset. Stop at
+  // the last contiguous byte; binary clients RESUME from there.
+  Serial.printf("[%s] Inbox full, stream %08X lost data after %u bytes\n",
+                TAG, streamSession_, streamOffset_);
+  WBPStreamPosition pos = {streamSession_, streamOffset_, 0};
+  postReply(streamCmd_, CommandStatus::DATA_LOST, "ERR:DATA_LOST",
+            (const uint8_t *)&pos, sizeof(pos), 0);
+  gapSuspended_ = suspendStream();
+}
+
+bool Controller::isResume(const uint8_t *data, size_t len) {
+  return len == sizeof(WBPCommandHeader) + sizeof(WBPResumeArgs) &&
+         data[0] == (uint8_t)CommandOp::RESUME;
+}
+
+void Controller::handleDisconnect() {
+  if (streamType_ != NONE && !streamSuspended_)
+    suspendStream();
+  gapSuspended_ = false; // Nothing in flight survives the link
+
+  rxContinuation_ = false;
+  cancelTransfer();
+  dropReplies(); // Answers for the old connection
+  engine_.setDebugMode(false);
+  engine_.clearDebugSignals();
+}
+
+const Controller::CommandFn Controller::commandTable_[WBP_CMD_COUNT] = {
+    nullptr,                     // 0x80 reserved
+    &Controller::cmdGetProfile,  // GET_PROFILE
+    &Controller::cmdGetRules,    // GET_RULES
+    &Controller::cmdDebugStart,  // DEBUG_START
+    &Controller::cmdDebugStop,   // DEBUG_STOP
+    &Controller::cmdDebugSync,   // DEBUG_SYNC
+    &Controller::cmdStream,      // DEBUG_WATCH
+    &Controller::cmdStream,      // SET_RULES_RAM
+    &Controller::cmdStream,      // SET_RULES_NVS
+    &Controller::cmdOtaBegin,    // OTA_BEGIN
+    &Controller::cmdOtaBegin,    // OTA_DELTA
+    &Controller::cmdOtaCancel,   // OTA_CANCEL
+    &Controller::cmdResume,      // RESUME
+    nullptr,                     // STREAM_ACK (response only)
+    &Controller::cmdOtaBegin,    // OTA_BEGIN_Z
+};
+
+void Controller::handleCommand(const uint8_t *data, size_t len) {
+  Command cmd;
+
+  if (Protocol::isBinaryCommand(data, len)) {
+#if W4RP_LOG_COMMANDS
+    Serial.printf("[%s] CMD: 0x%02X #%u\n", TAG, data[0],
+                  len > 1 ? data[1] : 0);
+#endif
+    CommandStatus status = Protocol::parseCommand(data, len, cmd);
+    if (status != CommandStatus::OK) {
+      reply(cmd, status, nullptr);
+      return;
     }
-    return;
+  } else {
+#if W4RP_LOG_COMMANDS
+    Serial.printf("[%s] CMD: %.*s\n", TAG, (int)len, (const char *)data);
+#endif
+    if (!Protocol::parseTextCommand(data, len, cmd))
+      return;
+  }
+
+  CommandFn fn = commandTable_[(uint8_t)cmd.op & 0x7F];
+  (this->*fn)(cmd);
+}
+
+void Controller::reply(const Command &cmd, CommandStatus status,
+                       const char *text, const uint8_t *payload,
+                       size_t payloadLen) {
+  postReply(cmd, status, text, payload, payloadLen, REPLY_RESERVE);
+}
+
+bool Controller::postReply(const Command &cmd, CommandStatus status,
+                           const char *text, const uint8_t *payload,
+                           size_t payloadLen, size_t reserve) {
+  uint8_t frame[sizeof(WBPResponse) + 64];
+  size_t len = 0;
+
+  if (cmd.binary) {
+    len = Protocol::buildResponse(frame, sizeof(frame), cmd, status, payload,
+                                  payloadLen);
+  } else if (text) {
+    len = strnlen(text, sizeof(frame));
+    memcpy(frame, text, len);
+  } else {
+    return true;
   }
 
-  // SET:RULES:RAM:<len>:<crc>
-  if (packet.startsWith("SET:RULES:RAM:")) {
-    int colon1 = packet.indexOf(':', 14);
-    if (colon1 > 14) {
-      streamExpectedLen_ = packet.substring(14, colon1).toInt();
-      streamExpectedCRC_ =
-          strtoul(packet.substring(colon1 + 1).c_str(), nullptr, 10);
-      streamType_ = RULESET_RAM;
-      streamBuffer_.clear();
-      streamBuffer_.reserve(streamExpectedLen_);
+  // Held behind a transfer or earlier replies, and while the transport has
+  // no credit: a driver with a full TX queue would drop it
+  if (txPhase_ != TX_IDLE || replyQueue_.size() > 0 ||
+      transport_->txCredits() == 0) {
+    if (replyQueue_.size() + reserve >= W4RP_REPLY_QUEUE_SLOTS ||
+        !replyQueue_.push(frame, len)) {
+      Serial.printf("[%s] Reply queue full, reply dropped\n", TAG);
+      return false;
     }
+    return true;
+  }
+
+  transport_->send(frame, len);
+  return true;
+}
+
+void Controller::flushReplies() {
+  PacketRing<W4RP_REPLY_QUEUE_SLOTS, sizeof(WBPResponse) + 64>::Packet pkt;
+  while (transport_->txCredits() > 0 && replyQueue_.front(pkt)) {
+    transport_->send(pkt.data, pkt.len);
+    replyQueue_.pop();
+  }
+}
+
+void Controller::dropReplies() {
+  PacketRing<W4RP_REPLY_QUEUE_SLOTS, sizeof(WBPResponse) + 64>::Packet pkt;
+  while (replyQueue_.front(pkt))
+    replyQueue_.pop();
+}
+
+void Controller::cmdGetProfile(const Command &cmd) { sendProfile(cmd); }
+
+void Controller::cmdGetRules(const Command &cmd) { sendRules(cmd); }
+
+void Controller::cmdDebugStart(const Command &cmd) {
+  engine_.setDebugMode(true);
+  reply(cmd, CommandStatus::OK, nullptr);
+}
+
+void Controller::cmdDebugStop(const Command &cmd) {
+  engine_.setDebugMode(false);
+  engine_.clearDebugSignals();
+  reply(cmd, CommandStatus::OK, nullptr);
+}
+
+// Client lost a frame (sequence gap), resend baselines
+void Controller::cmdDebugSync(const Command &cmd) {
+  engine_.resyncDebugSignals();
+  reply(cmd, CommandStatus::OK, nullptr);
+}
+
+// DEBUG:WATCH / SET:RULES:RAM / SET:RULES:NVS - <len>:<crc>, data, END
+void Controller::cmdStream(const Command &cmd) {
+  if (!fitsCapacity(streamBuffer_, cmd.length)) {
+    reply(cmd, CommandStatus::TOO_LARGE, "ERR:TOO_LARGE");
     return;
   }
 
-  // SET:RULES:NVS:<len>:<crc>
-  if (packet.startsWith("SET:RULES:NVS:")) {
-    int colon1 = packet.indexOf(':', 14);
-    if (colon1 > 14) {
-      streamExpectedLen_ = packet.substring(14, colon1).toInt();
-      streamExpectedCRC_ =
-          strtoul(packet.substring(colon1 + 1).c_str(), nullptr, 10);
-      streamType_ = RULESET_NVS;
-      streamBuffer_.clear();
-      streamBuffer_.reserve(streamExpectedLen_);
-    }
+  abortStream(); // A new stream replaces a suspended one
+
+  StreamType type = (cmd.op == CommandOp::DEBUG_WATCH)     ? DEBUG_WATCH
+                    : (cmd.op == CommandOp::SET_RULES_RAM) ? RULESET_RAM
+                                                           : RULESET_NVS;
+  openStream(cmd, type);
+  streamBuffer_.reserve(streamExpectedLen_);
+
+  WBPStreamPosition pos = streamPosition();
+  streamAckLimit_ = pos.offset + pos.window;
+  reply(cmd, CommandStatus::OK, nullptr, (const uint8_t *)&pos, sizeof(pos));
+}
+
+// OTA:BEGIN:<size>:<crc> / OTA:DELTA:<size>:<sourceCrc> /
+// OTA:ZBEGIN:<zsize>:<size>:<crc>
+void Controller::cmdOtaBegin(const Command &cmd) {
+  if (!otaService_) {
+    reply(cmd, CommandStatus::UNSUPPORTED, nullptr);
     return;
   }
 
-  // OTA commands (if service available)
-  if (otaService_ && packet.startsWith("OTA:")) {
-    // OTA:BEGIN:<size>:<crc>
-    if (packet.startsWith("OTA:BEGIN:")) {
-      int colon1 = packet.indexOf(':', 10);
-      if (colon1 > 10) {
-        uint32_t size = packet.substring(10, colon1).toInt();
-        uint32_t crc =
-            strtoul(packet.substring(colon1 + 1).c_str(), nullptr, 16);
-
-        if (otaService_->startFirmwareUpdate(size, crc)) {
-          streamType_ = OTA_FULL;
-          canBus_->stop();
-          transport_->send("OTA:READY");
-        } else {
-          transport_->send("OTA:ERROR");
-        }
-      }
-      return;
-    }
+  bool delta = cmd.op == CommandOp::OTA_DELTA;
 
-    // OTA:DELTA:<size>:<sourceCrc>
-    if (packet.startsWith("OTA:DELTA:")) {
-      int colon1 = packet.indexOf(':', 10);
-      if (colon1 > 10) {
-        uint32_t size = packet.substring(10, colon1).toInt();
-        uint32_t sourceCrc =
-            strtoul(packet.substring(colon1 + 1).c_str(), nullptr, 16);
-
-        if (otaService_->startDeltaUpdate(size, sourceCrc)) {
-          streamType_ = OTA_DELTA;
-          canBus_->stop();
-          transport_->send("OTA:READY");
-        } else {
-          transport_->send("OTA:ERROR");
-        }
-      }
-      return;
-    }
+  abortStream(); // A new image replaces a suspended one
 
-    // OTA:CANCEL - abort ongoing OTA update
-    if (packet == "OTA:CANCEL") {
-      if (streamType_ == OTA_FULL || streamType_ == OTA_DELTA) {
-        otaService_->abort();
-        streamType_ = NONE;
-        streamBuffer_.clear();
-        canBus_->resume();
-        transport_->send("OTA:CANCELLED");
-        Serial.printf("[%s] OTA cancelled by user\n", TAG);
-      }
-      return;
+  // Measure from here: the gap since this loop's rule pass covers the
+  // storage flush and the service's start below
+  otaStats_ = OtaStats();
+  otaStats_.active = true;
+  otaStartMs_ = millis();
+
+  storage_->commit(); // Flush pending writes before flash gets busy
+  bool started;
+  if (delta) {
+    started = otaService_->startDeltaUpdate(cmd.length, cmd.crc);
+  } else if (cmd.op == CommandOp::OTA_BEGIN_Z) {
+    // Compressed image goes down the full-image path, inflated in the driver
+    started = otaService_->startCompressedUpdate(cmd.length, cmd.imageSize,
+                                                 cmd.crc);
+  } else {
+    started = otaService_->startFirmwareUpdate(cmd.length, cmd.crc);
+  }
+
+  if (started) {
+    openStream(cmd, delta ? OTA_DELTA : OTA_FULL);
+    WBPStreamPosition pos = streamPosition();
+    reply(cmd, CommandStatus::OK, "OTA:READY", (const uint8_t *)&pos,
+          sizeof(pos));
+    if (cmd.binary) {
+      streamAckLimit_ = pos.offset + pos.window;
+    } else {
+      ackStream(); // Initial OTA:WIN for text clients
     }
+  } else {
+    otaStats_.active = false;
+    reply(cmd, CommandStatus::FAILED, "OTA:ERROR");
   }
 }
 
-void Controller::handleStreamData(const uint8_t *data, size_t len) {
-  String packet((char *)data, len);
+// OTA:CANCEL - abort ongoing OTA update
+void Controller::cmdOtaCancel(const Command &cmd) {
+  if (!otaService_) {
+    reply(cmd, CommandStatus::UNSUPPORTED, nullptr);
+    return;
+  }
 
+  if (streamType_ == OTA_FULL || streamType_ == OTA_DELTA) {
+    abortStream();
+    reply(cmd, CommandStatus::OK, "OTA:CANCELLED");
+    Serial.printf("[%s] OTA cancelled by user\n", TAG);
+  } else {
+    reply(cmd, CommandStatus::OK, nullptr);
+  }
+}
+
+// RESUME <session> - reattach to a suspended stream, client continues
+// sending from the returned offset
+void Controller::cmdResume(const Command &cmd) {
+  if (!streamSuspended_ || cmd.session != streamSession_) {
+    reply(cmd, CommandStatus::NO_SESSION, nullptr);
+    return;
+  }
+
+  streamSuspended_ = false;
+  gapSuspended_ = false;
+  Serial.printf("[%s] Stream %08X resumed at %u bytes\n", TAG,
+                streamSession_, streamOffset_);
+
+  WBPStreamPosition pos = streamPosition();
+  streamAckLimit_ = pos.offset + pos.window;
+  reply(cmd, CommandStatus::OK, nullptr, (const uint8_t *)&pos, sizeof(pos));
+}
+
+void Controller::handleStreamData(const uint8_t *data, size_t len,
+                                  bool fragment) {
   // Check for END marker
-  if (packet == "END") {
+  if (!fragment && len == 3 && memcmp(data, "END", 3) == 0) {
     finalizeStream();
     return;
   }
 
+  bool accepted = true;
+
   // OTA paths write directly to service
   if (streamType_ == OTA_FULL && otaService_) {
-    otaService_->writeFirmwareChunk(data, len);
-    return;
+    accepted = otaService_->writeFirmwareChunk(data, len);
+  } else if (streamType_ == OTA_DELTA && otaService_) {
+    accepted = otaService_->writeDeltaChunk(data, len);
+  } else {
+    // Buffer other streams
+    streamBuffer_.insert(streamBuffer_.end(), data, data + len);
   }
 
-  if (streamType_ == OTA_DELTA && otaService_) {
-    otaService_->writeDeltaChunk(data, len);
-    return;
+  // Offset only advances over bytes that actually landed
+  if (accepted) {
+    streamOffset_ += len;
+    if (streamOffset_ - streamAckOffset_ >= W4RP_STREAM_ACK_BYTES)
+      ackStream();
   }
-
-  // Buffer other streams
-  streamBuffer_.insert(streamBuffer_.end(), data, data + len);
 }
 
 void Controller::finalizeStream() {
-  Serial.printf("[%s] Stream END. Received %d bytes\n", TAG,
-                streamBuffer_.size());
+  Serial.printf("[%s] Stream END. Received %u bytes\n", TAG, streamOffset_);
 
   // Handle OTA finalization
   if (streamType_ == OTA_FULL && otaService_) {
     if (otaService_->finalizeFirmwareUpdate()) {
-      transport_->send("OTA:SUCCESS");
+      reply(streamCmd_, CommandStatus::OK, "OTA:SUCCESS");
+      finishOtaStats();
+      storage_->commit();
       delay(1000);
       esp_restart();
     } else {
-      transport_->send("OTA:ERROR");
-      canBus_->resume();
+      replyOtaError(otaService_->getStatus());
+      otaService_->abort(); // Release the handle, back to IDLE
     }
     streamType_ = NONE;
     return;
@@ -318,8 +696,7 @@ void Controller::finalizeStream() {
     if (otaService_->finalizeDeltaUpdate()) {
       // Delta task handles completion
     } else {
-      transport_->send("OTA:ERROR");
-      canBus_->resume();
+      reply(streamCmd_, CommandStatus::FAILED, "OTA:ERROR");
     }
     streamType_ = NONE;
     return;
@@ -327,7 +704,7 @@ void Controller::finalizeStream() {
 
   // Verify length
   if (streamBuffer_.size() != streamExpectedLen_) {
-    transport_->send("ERR:LEN_MISMATCH");
+    reply(streamCmd_, CommandStatus::LEN_MISMATCH, "ERR:LEN_MISMATCH");
     streamType_ = NONE;
     streamBuffer_.clear();
     return;
@@ -337,7 +714,7 @@ void Controller::finalizeStream() {
   uint32_t calcCrc =
       Protocol::calculateCRC32(streamBuffer_.data(), streamBuffer_.size());
   if (calcCrc != streamExpectedCRC_) {
-    transport_->send("ERR:CRC_FAIL");
+    reply(streamCmd_, CommandStatus::CRC_FAIL, "ERR:CRC_FAIL");
     streamType_ = NONE;
     streamBuffer_.clear();
     return;
@@ -345,14 +722,17 @@ void Controller::finalizeStream() {
 
   // Process based on stream type
   if (streamType_ == DEBUG_WATCH) {
-    String defs((char *)streamBuffer_.data(), streamBuffer_.size());
-    size_t count = engine_.loadDebugSignals(defs);
+    size_t count =
+        engine_.loadDebugSignals(streamBuffer_.data(), streamBuffer_.size());
+    debugSeq_ = 0;
     Serial.printf("[%s] Loaded %d debug signals\n", TAG, count);
 
     // Send acknowledgment
     char response[32];
     snprintf(response, sizeof(response), "DEBUG:OK:%d", (int)count);
-    transport_->send(response);
+    uint16_t count16 = (uint16_t)count;
+    reply(streamCmd_, CommandStatus::OK, response, (const uint8_t *)&count16,
+          sizeof(count16));
   } else if (streamType_ == RULESET_RAM || streamType_ == RULESET_NVS) {
     if (engine_.loadRuleset(streamBuffer_.data(), streamBuffer_.size())) {
       // All validations passed, accept ruleset
@@ -364,18 +744,19 @@ void Controller::finalizeStream() {
 
       Serial.printf("[%s] Loaded ruleset: %d signals, %d rules\n", TAG,
                     engine_.getSignalCount(), engine_.getRuleCount());
+      reply(streamCmd_, CommandStatus::OK, nullptr);
     } else {
       // Check if failure was due to unknown capability
-      String unknownCap = engine_.getUnknownCapability();
-      if (!unknownCap.isEmpty()) {
+      const char *unknownCap = engine_.getUnknownCapability();
+      if (unknownCap[0] != '\0') {
         char errMsg[64];
-        snprintf(errMsg, sizeof(errMsg), "ERR:CAP_UNKNOWN:%s",
-                 unknownCap.c_str());
-        transport_->send(errMsg);
+        snprintf(errMsg, sizeof(errMsg), "ERR:CAP_UNKNOWN:%s", unknownCap);
+        reply(streamCmd_, CommandStatus::CAP_UNKNOWN, errMsg,
+              (const uint8_t *)unknownCap, strlen(unknownCap));
         Serial.printf("[%s] Rejected ruleset: unknown capability '%s'\n", TAG,
-                      unknownCap.c_str());
+                      unknownCap);
       } else {
-        transport_->send("ERR:RULES_INVALID");
+        reply(streamCmd_, CommandStatus::INVALID, "ERR:RULES_INVALID");
       }
     }
   }
@@ -384,67 +765,145 @@ void Controller::finalizeStream() {
   streamBuffer_.clear();
 }
 
-void Controller::sendProfile() {
-  uint8_t buffer[2048];
+void Controller::sendProfile(const Command &cmd) {
+  if (txPhase_ != TX_IDLE) {
+    reply(cmd, CommandStatus::BUSY, "ERR:BUSY");
+    return;
+  }
 
-  // Build capability list
-  std::vector<std::pair<String, CapabilityMeta>> caps;
-  for (const auto &entry : engine_.getCapabilities()) {
-    caps.push_back({entry.first, entry.second});
+  if (!refreshProfile()) {
+    reply(cmd, CommandStatus::TOO_LARGE, "ERR:PROFILE_TOO_LARGE");
+    return;
   }
 
+  // Safe to patch in place: the cache is never rebuilt mid-transfer
+  uint32_t uptime = millis();
+  memcpy(profileCache_.data() + offsetof(WBPProfileHeader, uptimeMs), &uptime,
+         sizeof(uptime));
+
+  reply(cmd, CommandStatus::OK, nullptr);
+  startTransfer(profileCache_.data(), profileCache_.size());
+}
+
+bool Controller::refreshProfile() {
+  if (profileValid_ && profileGeneration_ == engine_.getGeneration() &&
+      profileRulesMode_ == rulesMode_)
+    return true;
+
+  profileCache_.clear();
   size_t len = Protocol::serializeProfile(
-      buffer, sizeof(buffer), moduleId_.c_str(), hwVersion_.c_str(),
-      fwVersion_.c_str(), serialNumber_.c_str(), millis(), bootCount_,
-      rulesMode_, engine_.getRulesetCRC(), engine_.getSignalCount(),
+      [this](const uint8_t *data, size_t len) {
+        profileCache_.insert(profileCache_.end(), data, data + len);
+      },
+      moduleId_.c_str(), hwVersion_.c_str(), fwVersion_.c_str(),
+      serialNumber_.c_str(), 0, bootCount_, rulesMode_,
+      engine_.getRulesetCRC(), engine_.getSignalCount(),
       engine_.getConditionCount(), engine_.getActionCount(),
-      engine_.getRuleCount(), caps);
+      engine_.getRuleCount(), engine_.getCapabilities());
+
+  // Static-capacity builds truncate at W4RP_MAX_PROFILE_BYTES
+  profileValid_ = len > 0 && profileCache_.size() == len;
+  profileGeneration_ = engine_.getGeneration();
+  profileRulesMode_ = rulesMode_;
+  profileCache_.shrink_to_fit();
+  return profileValid_;
+}
 
-  if (len == 0) {
-    transport_->send("ERR:PROFILE_TOO_LARGE");
+void Controller::sendRules(const Command &cmd) {
+  if (txPhase_ != TX_IDLE) {
+    reply(cmd, CommandStatus::BUSY, "ERR:BUSY");
     return;
   }
 
-  // Send chunked
-  transport_->send("BEGIN");
-  delay(10);
+  const auto &rules = engine_.getRulesetBinary();
 
-  size_t mtu = transport_->getMTU();
-  for (size_t offset = 0; offset < len; offset += mtu) {
-    size_t chunkLen = (len - offset > mtu) ? mtu : (len - offset);
-    transport_->send(buffer + offset, chunkLen);
-    delay(5);
+  if (rules.empty()) {
+    reply(cmd, CommandStatus::NO_RULES, "ERR:NO_RULES");
+    return;
   }
 
-  char endMsg[64];
-  snprintf(endMsg, sizeof(endMsg), "END:%d:%u", (int)len,
-           Protocol::calculateCRC32(buffer, len));
-  transport_->send(endMsg);
+  // Snapshot: a SET:RULES during the transfer must not tear it
+  txBuffer_.assign(rules.begin(), rules.end());
+  reply(cmd, CommandStatus::OK, nullptr);
+  startTransfer(txBuffer_.data(), txBuffer_.size());
 }
 
-void Controller::sendRules() {
-  const auto &rules = engine_.getRulesetBinary();
+bool Controller::startTransfer(const uint8_t *data, size_t len) {
+  if (txPhase_ != TX_IDLE)
+    return false;
 
-  if (rules.empty()) {
-    transport_->send("ERR:NO_RULES");
-    return;
-  }
+  txData_ = data;
+  txLen_ = len;
+  txOffset_ = 0;
+  txCrc_ = Protocol::calculateCRC32(data, len);
+  txStartMs_ = millis();
+  txPhase_ = TX_BEGIN;
 
-  transport_->send("BEGIN");
-  delay(10);
+  txStats_ = TransferStats();
+  txStats_.active = true;
 
-  size_t mtu = transport_->getMTU();
-  for (size_t offset = 0; offset < rules.size(); offset += mtu) {
-    size_t chunkLen =
-        (rules.size() - offset > mtu) ? mtu : (rules.size() - offset);
-    transport_->send(rules.data() + offset, chunkLen);
-    delay(5);
+  pumpTransfer();
+  return true;
+}
+
+void Controller::pumpTransfer() {
+  size_t budget = W4RP_TX_CHUNKS_PER_LOOP;
+  size_t credits = transport_->txCredits();
+  if (credits < budget)
+    budget = credits;
+
+  while (budget > 0 && txPhase_ != TX_IDLE) {
+    switch (txPhase_) {
+    case TX_BEGIN:
+      transport_->send("BEGIN");
+      txPhase_ = TX_DATA;
+      break;
+
+    case TX_DATA: {
+      // Query per chunk: MTU may change mid-transfer
+      size_t mtu = transport_->getMTU();
+      size_t remaining = txLen_ - txOffset_;
+      size_t chunkLen = (remaining > mtu) ? mtu : remaining;
+      transport_->send(txData_ + txOffset_, chunkLen);
+      txOffset_ += chunkLen;
+      txStats_.bytes += chunkLen;
+      txStats_.chunks++;
+      txStats_.mtu = chunkLen > txStats_.mtu ? chunkLen : txStats_.mtu;
+      if (txOffset_ >= txLen_)
+        txPhase_ = TX_END;
+      break;
+    }
+
+    case TX_END: {
+      char endMsg[64];
+      snprintf(endMsg, sizeof(endMsg), "END:%d:%u", (int)txLen_, txCrc_);
+      transport_->send(endMsg);
+      txStats_.durationMs = millis() - txStartMs_;
+      txStats_.throughputBps =
+          txStats_.durationMs
+              ? (uint32_t)((uint64_t)txStats_.bytes * 1000 /
+                           txStats_.durationMs)
+              : txStats_.bytes * 1000;
+      txStats_.active = false;
+      txPhase_ = TX_IDLE;
+      txData_ = nullptr;
+      txBuffer_.clear();
+      txBuffer_.shrink_to_fit();
+      break;
+    }
+
+    default:
+      break;
+    }
+    budget--;
   }
+}
 
-  char endMsg[64];
-  snprintf(endMsg, sizeof(endMsg), "END:%d:%u", (int)rules.size(),
-           engine_.getRulesetCRC());
-  transport_->send(endMsg);
+void Controller::cancelTransfer() {
+  txPhase_ = TX_IDLE;
+  txStats_.active = false;
+  txData_ = nullptr;
+  txBuffer_.clear();
 }
 
 void Controller::sendStatus() {
@@ -452,10 +911,11 @@ void Controller::sendStatus() {
     return;
 
   char status[128];
-  snprintf(status, sizeof(status), "S:%d:%d:%d:%d:%lu:%d", rulesMode_,
+  snprintf(status, sizeof(status), "S:%d:%d:%d:%d:%lu:%d:%u:%u", rulesMode_,
            (int)engine_.getSignalCount(), (int)engine_.getRuleCount(),
            (int)engine_.getSignalCount(), // Unique CAN IDs (simplified)
-           millis(), bootCount_);
+           millis(), bootCount_, (unsigned)transport_->getMTU(),
+           txStats_.throughputBps);
 
   transport_->sendStatus((uint8_t *)status, strlen(status));
 }
@@ -465,14 +925,22 @@ void Controller::sendDebugUpdates() {
   if (now - lastDebugTxMs_ < 10)
     return; // Rate limit
 
-  RuntimeSignal sig;
-  if (engine_.popDirtyDebugSignal(sig)) {
-    char msg[128];
-    snprintf(msg, sizeof(msg), "D:S:%u:%u:%u:%d:%.4f:%.4f:%.2f", sig.canId,
-             sig.startBit, sig.bitLength, sig.bigEndian ? 1 : 0, sig.factor,
-             sig.offset, sig.value);
+  size_t budget = transport_->txCredits();
+  if (budget > W4RP_TX_CHUNKS_PER_LOOP)
+    budget = W4RP_TX_CHUNKS_PER_LOOP;
+
+  uint8_t frame[W4RP_DEBUG_FRAME_MAX];
+  size_t frameMax = transport_->getMTU();
+  if (frameMax > sizeof(frame))
+    frameMax = sizeof(frame);
+
+  while (budget-- > 0) {
+    size_t len = engine_.buildDebugFrame(frame, frameMax, debugSeq_);
+    if (len == 0)
+      break;
 
-    transport_->send(msg);
+    transport_->send(frame, len);
+    debugSeq_++;
     lastDebugTxMs_ = now;
   }
 }
@@ -19,7 +19,7 @@
  * void setup() {
  *   controller.setModuleInfo("W4RP_V1", "0.5.0", "DEV-001");
  *   controller.begin();
- *   controller.registerCapability("log", myHandler, myMeta);
+ *   controller.registerCapability<kLog>(onLog); // constexpr CapabilityDef
  * }
  *
  * void loop() {
@@ -37,10 +37,17 @@
 #include "src/interfaces/Storage.h"
 
 // Core
+#include "src/core/ConditionKernel.h"
 #include "src/core/Engine.h"
+#include "src/core/PacketRing.h"
 #include "src/core/Protocol.h"
 #include "src/core/Types.h"
 
+// Portable drivers
+#include "src/drivers/CachedStorage.h"
+#include "src/drivers/LoopbackTransport.h"
+#include "src/drivers/PageCache.h"
+
 // ESP32 Drivers (optional - user can provide their own)
 #ifdef ESP32
 #include "src/drivers/BLETransport.h"
@@ -51,6 +58,85 @@
 
 namespace W4RP {
 
+/// Max bulk chunks pushed per loop() pass (bounds loop stall)
+#ifndef W4RP_TX_CHUNKS_PER_LOOP
+#define W4RP_TX_CHUNKS_PER_LOOP 4
+#endif
+
+/// Receive inbox slots (power of two) and bytes per slot
+#ifndef W4RP_RX_RING_SLOTS
+#define W4RP_RX_RING_SLOTS 16
+#endif
+#ifndef W4RP_RX_SLOT_SIZE
+#define W4RP_RX_SLOT_SIZE 244
+#endif
+
+/// Replies held back while a bulk transfer owns the TX channel or the
+/// transport has no credit; the last two slots are kept for stream control
+#ifndef W4RP_REPLY_QUEUE_SLOTS
+#define W4RP_REPLY_QUEUE_SLOTS 8
+#endif
+
+/// How long a binary stream survives a disconnect, waiting for RESUME
+#ifndef W4RP_RESUME_TIMEOUT_MS
+#define W4RP_RESUME_TIMEOUT_MS 120000
+#endif
+
+/// Bytes between STREAM_ACK offset acknowledgements
+#ifndef W4RP_STREAM_ACK_BYTES
+#define W4RP_STREAM_ACK_BYTES 4096
+#endif
+
+/// Advertise the stream window again once it has grown this much
+#ifndef W4RP_STREAM_WINDOW_STEP
+#define W4RP_STREAM_WINDOW_STEP 1024
+#endif
+
+/// Log every command on Serial (text commands printed verbatim)
+#ifndef W4RP_LOG_COMMANDS
+#define W4RP_LOG_COMMANDS 0
+#endif
+
+/// Largest binary debug frame (bytes); frames are also capped at the MTU
+#ifndef W4RP_DEBUG_FRAME_MAX
+#define W4RP_DEBUG_FRAME_MAX 244
+#endif
+
+/// Largest ruleset / watch list stream (static-capacity builds)
+#ifndef W4RP_MAX_STREAM_BYTES
+#define W4RP_MAX_STREAM_BYTES W4RP_MAX_RULESET_BYTES
+#endif
+
+/// Largest encoded profile (static-capacity builds)
+#ifndef W4RP_MAX_PROFILE_BYTES
+#define W4RP_MAX_PROFILE_BYTES 4096
+#endif
+
+/**
+ * @struct TransferStats
+ * @brief Last device-to-client bulk transfer (profile / rules)
+ */
+struct TransferStats {
+  uint32_t bytes = 0;       ///< Payload bytes sent
+  uint32_t chunks = 0;      ///< Notifications sent
+  uint32_t durationMs = 0;  ///< BEGIN to END
+  uint32_t throughputBps = 0; ///< Effective payload bytes/s
+  uint16_t mtu = 0;         ///< Largest chunk sent (negotiated MTU - 3)
+  uint32_t maxLoopUs = 0;   ///< Longest loop() pass while transferring
+  bool active = false;      ///< Transfer still in progress
+};
+
+/**
+ * @struct OtaStats
+ * @brief Rule responsiveness during the last OTA update
+ */
+struct OtaStats {
+  uint32_t maxRuleLatencyUs = 0; ///< Longest gap between rule evaluations
+  uint32_t evaluations = 0;      ///< evaluateRules() passes during the update
+  uint32_t durationMs = 0;       ///< Start to completion / abort
+  bool active = false;           ///< Update still in progress
+};
+
 /**
  * @brief Main W4RP controller - orchestrates all components
  *
@@ -93,16 +179,39 @@ public:
    * @brief Register a capability handler
    * @warning Handlers are called with internal mutex held - don't call
    * controller methods inside!
+   * @return false if W4RP_MAX_CAPABILITIES is reached (static capacity)
    */
-  void registerCapability(const String &id, CapabilityHandler handler);
-  void registerCapability(const String &id, CapabilityHandler handler,
+  bool registerCapability(const String &id, CapabilityHandler handler);
+  bool registerCapability(const String &id, CapabilityHandler handler,
                           const CapabilityMeta &meta);
 
+  /**
+   * @brief Register a typed capability from constant data
+   * The handler's arguments are checked against Def's parameter schema at
+   * compile time, e.g. void(int32_t, float) for an INT, FLOAT schema.
+   * @tparam Def constexpr CapabilityDef at namespace scope (stays in flash)
+   * @param handler Function, lambda or functor
+   * @return false if W4RP_MAX_CAPABILITIES is reached (static capacity)
+   */
+  template <const CapabilityDef &Def, typename F>
+  bool registerCapability(F handler) {
+    return engine_.registerCapability(Def, makeInvoker<Def>(handler));
+  }
+
   bool isConnected() const;
   uint32_t getUptime() const { return millis(); }
   uint16_t getBootCount() const { return bootCount_; }
   uint8_t getRulesMode() const { return rulesMode_; }
   Engine &getEngine() { return engine_; }
+  const TransferStats &getTransferStats() const { return txStats_; }
+  const OtaStats &getOtaStats() const { return otaStats_; }
+  uint32_t getRxDropped() const { return rxRing_.dropped(); }
+
+  /**
+   * @brief Set how long an interrupted binary stream waits for RESUME
+   * @param ms Timeout (0 = discard on disconnect, like text streams)
+   */
+  void setResumeTimeout(uint32_t ms) { resumeTimeoutMs_ = ms; }
 
 private:
   CAN *canBus_;
@@ -134,45 +243,227 @@ private:
     OTA_DELTA
   };
   StreamType streamType_ = NONE;
-  std::vector<uint8_t> streamBuffer_;
+  CapacityVector<uint8_t, W4RP_MAX_STREAM_BYTES> streamBuffer_;
   uint32_t streamExpectedLen_ = 0;
   uint32_t streamExpectedCRC_ = 0;
+  Command streamCmd_; // Answered again after END
+
+  // Resumable sessions (binary streams only)
+  uint32_t streamSession_ = 0;
+  uint32_t streamOffset_ = 0;    // Highest contiguous byte accepted
+  uint32_t streamAckOffset_ = 0; // Last offset sent in STREAM_ACK
+  uint32_t streamAckLimit_ = 0;  // Last offset + window advertised
+  bool streamSuspended_ = false; // Link dropped, waiting for RESUME
+  bool gapSuspended_ = false;    // Suspended by an inbox gap: the client's
+                                 // in-flight data is dropped until RESUME
+  uint32_t suspendedAtMs_ = 0;
+  uint16_t sessionCounter_ = 0;
+  uint32_t resumeTimeoutMs_ = W4RP_RESUME_TIMEOUT_MS;
+
+  // Receive inbox: transport task pushes, loop() drains
+  PacketRing<W4RP_RX_RING_SLOTS, W4RP_RX_SLOT_SIZE> rxRing_;
+  std::atomic<bool> linkDropped_{false};
+  bool rxContinuation_ = false;
+
+  // Replies issued during a bulk transfer or without a TX credit
+  PacketRing<W4RP_REPLY_QUEUE_SLOTS, sizeof(WBPResponse) + 64> replyQueue_;
 
   uint32_t lastStatusMs_ = 0;
   uint32_t lastDebugTxMs_ = 0;
+  uint8_t debugSeq_ = 0;
+
+  // Bulk transfer state (device -> client)
+  enum TxPhase { TX_IDLE, TX_BEGIN, TX_DATA, TX_END };
+  TxPhase txPhase_ = TX_IDLE;
+  RulesetBinary txBuffer_; // Snapshot for transfers that need one
+  const uint8_t *txData_ = nullptr; // Bytes being sent
+  size_t txLen_ = 0;
+  size_t txOffset_ = 0;
+  uint32_t txCrc_ = 0;
+  uint32_t txStartMs_ = 0;
+  TransferStats txStats_;
+
+  // Encoded profile, rebuilt only when its inputs change
+  CapacityVector<uint8_t, W4RP_MAX_PROFILE_BYTES> profileCache_;
+  bool profileValid_ = false;
+  uint32_t profileGeneration_ = 0; ///< Engine generation it was built from
+  uint8_t profileRulesMode_ = 0;
+
+  // Rule latency while an OTA update runs alongside CAN processing
+  OtaStats otaStats_;
+  uint32_t otaStartMs_ = 0;
+  uint32_t lastRuleUs_ = 0;
+
+  /** @brief Record the gap since the previous rule pass */
+  void trackRuleLatency();
+
+  /** @brief Close OtaStats once the update has left its busy states */
+  void finishOtaStats();
+
+  /** @brief Drain the receive inbox (runs in loop(), never in callbacks) */
+  void processInbox();
+
+  /** @brief Reset per-connection state after the link dropped */
+  void handleDisconnect();
 
-  /** @brief Parse and dispatch incoming command packet */
+  /**
+   * @brief Keep a binary stream for RESUME, abort any other
+   * @return true if suspended
+   */
+  bool suspendStream();
+
+  /** @brief Fail the open stream at its offset after inbox packets dropped */
+  void handleInboxGap();
+
+  /** @brief True if the packet is a binary RESUME command */
+  static bool isResume(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Decode command packet and dispatch through commandTable_
+   * Binary commands (bit 7 set) are decoded in place; text commands go
+   * through Protocol::parseTextCommand into the same handlers.
+   */
   void handleCommand(const uint8_t *data, size_t len);
 
-  /** @brief Accumulate streamed binary data or forward to OTA */
-  void handleStreamData(const uint8_t *data, size_t len);
+  /**
+   * @brief Answer a command
+   * Binary: WBP_CMD_RESPONSE frame with requestId. Text: legacy string
+   * (nothing sent if text is nullptr). Queued while a transfer is active
+   * so replies never land between BEGIN and END, and while the transport
+   * has no TX credit.
+   */
+  void reply(const Command &cmd, CommandStatus status, const char *text,
+             const uint8_t *payload = nullptr, size_t payloadLen = 0);
+
+  /**
+   * @brief reply() with a given share of the reply queue
+   * Stream control (STREAM_ACK, OTA:WIN, DATA_LOST) uses slots ordinary
+   * replies leave free, so it is never lost behind them.
+   * @param reserve Queue slots that must stay free after this reply
+   * @return false if the reply was dropped
+   */
+  bool postReply(const Command &cmd, CommandStatus status, const char *text,
+                 const uint8_t *payload, size_t payloadLen, size_t reserve);
+
+  /** @brief Send deferred replies while the transport has credits */
+  void flushReplies();
+
+  /** @brief Discard deferred replies (link dropped) */
+  void dropReplies();
+
+  // Command handlers (indexed by opcode & 0x7F)
+  using CommandFn = void (Controller::*)(const Command &cmd);
+  static const CommandFn commandTable_[WBP_CMD_COUNT];
+
+  void cmdGetProfile(const Command &cmd);
+  void cmdGetRules(const Command &cmd);
+  void cmdDebugStart(const Command &cmd);
+  void cmdDebugStop(const Command &cmd);
+  void cmdDebugSync(const Command &cmd);
+  void cmdStream(const Command &cmd);
+  void cmdOtaBegin(const Command &cmd);
+  void cmdOtaCancel(const Command &cmd);
+  void cmdResume(const Command &cmd);
+
+  /** @brief Open a new stream session (drops any suspended one) */
+  void openStream(const Command &cmd, StreamType type);
+
+  /** @brief Drop stream state and abort the OTA update, if any */
+  void abortStream();
+
+  /** @brief Session, offset and window of the current stream */
+  WBPStreamPosition streamPosition() const;
+
+  /**
+   * @brief Stream bytes the inbox holds when filled with MTU-sized packets
+   * Caps every stream window: bytes past the stream offset wait there.
+   */
+  size_t inboxWindow() const;
+
+  /**
+   * @brief Check the stream can take a packet now
+   * OTA data beyond the service window stays in the inbox until the
+   * service drains (never blocks, never drops).
+   */
+  bool streamAccepts(const uint8_t *data, size_t len, bool fragment) const;
+
+  /**
+   * @brief Send STREAM_ACK (binary) / OTA:WIN (text OTA) with offset and
+   * window; also called from loop() when the window grows
+   */
+  void ackStream();
+
+  /** @brief Report and drop an OTA stream the service has failed */
+  void checkOtaStream();
+
+  /** @brief Reply to the OTA stream with the error matching status */
+  void replyOtaError(OTAStatus status);
+
+  /**
+   * @brief Accumulate streamed binary data or forward to OTA
+   * @param fragment Part of a longer packet (never an END marker)
+   */
+  void handleStreamData(const uint8_t *data, size_t len,
+                        bool fragment = false);
 
   /** @brief Validate CRC, apply buffered data based on stream type */
   void finalizeStream();
 
   /**
-   * @brief Serialize and send module profile as chunked WBP binary
+   * @brief Queue the module profile as a bulk transfer
    * Includes: moduleId, hw/fw version, serial, uptime, bootCount,
    * rulesMode, rulesCRC, signal/condition/action/rule counts, capabilities
    * Format: BEGIN → binary chunks → END:<len>:<crc>
+   * Sent straight from the cached encoding; only uptime is patched in.
+   */
+  void sendProfile(const Command &cmd);
+
+  /**
+   * @brief Re-encode the profile into profileCache_ if stale
+   * Stale after capability / ruleset changes (Engine generation),
+   * a rules mode change, or setModuleInfo().
+   * @return false if the profile exceeds the WBP format limits
    */
-  void sendProfile();
+  bool refreshProfile();
 
   /**
-   * @brief Send current ruleset binary to client
+   * @brief Queue current ruleset binary as a bulk transfer
    * Format: BEGIN → binary chunks → END:<len>:<crc>
    * Returns ERR:NO_RULES if no ruleset loaded
    */
-  void sendRules();
+  void sendRules(const Command &cmd);
+
+  /**
+   * @brief Start sending data (BEGIN → chunks → END)
+   * @param data Must stay unchanged until the transfer ends
+   * @param len Data length
+   * @return false if another transfer is still running
+   */
+  bool startTransfer(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Push pending chunks while the transport has credits
+   * Called every loop(), never sleeps
+   */
+  void pumpTransfer();
+
+  /** @brief Drop an in-flight transfer (disconnect) */
+  void cancelTransfer();
 
   /**
    * @brief Send status via status characteristic (every 5s when connected)
    * Format:
    * S:<rulesMode>:<signalCount>:<ruleCount>:<canIds>:<uptimeMs>:<bootCount>
+   *   :<mtu>:<txBps>
+   * mtu = current chunk size, txBps = throughput of the last bulk transfer
    */
   void sendStatus();
 
-  /** @brief Push dirty debug signal values to client (rate-limited) */
+  /**
+   * @brief Push changed debug values as binary telemetry frames
+   * Every 10 ms, up to the transport's credits; each frame fills the MTU.
+   * Format: [0xD1][flags][seq][count] + (varint idx, zigzag raw delta)*
+   */
   void sendDebugUpdates();
 
   /** @brief Set LED based on connection state (call every loop, stateless) */
@@ -17,17 +17,12 @@ ESP32OTAService otaService;
 
 Controller w4rp(&canBus, &storage, &transport, &otaService);
 
-CapabilityMeta logMeta = {.id = "log",
-                          .label = "Log Message",
-                          .description = "Print to Serial",
-                          .category = "debug"};
+constexpr CapabilityParamDef kLogParams[] = {
+    {"message", ParamType::STRING, true, 0, 0, "Text to print"}};
+constexpr CapabilityDef kLog("log", "Log Message", "Print to Serial", "debug",
+                             kLogParams);
 
-void onLog(const ParamMap &params) {
-  auto it = params.find("p0");
-  if (it != params.end()) {
-    Serial.printf("[LOG] %s\n", it->second.c_str());
-  }
-}
+void onLog(const char *message) { Serial.printf("[LOG] %s\n", message); }
 
 void onOTAProgress(const OTAProgress &progress) {
   Serial.printf("[OTA] %d%% (%u/%u bytes)\n", progress.percentage,
@@ -55,7 +50,7 @@ void setup() {
 
   w4rp.setModuleInfo("W4RP_OTA", "1.0.0", "DEV-OTA");
   w4rp.setLedPin(8);
-  w4rp.registerCapability("log", onLog, logMeta);
+  w4rp.registerCapability<kLog>(onLog);
   w4rp.begin();
 
   Serial.println("OTA commands:");
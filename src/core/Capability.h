@@ -0,0 +1,223 @@
+/**
+ * @file Capability.h
+ * @brief CORE:Capability - Compile-time capability definitions
+ * @version 1.0.0
+ *
+ * A capability is described by constant data (CapabilityDef +
+ * CapabilityParamDef[]) that lives in flash: no String fields, no heap.
+ * Typed handlers such as void(int32_t, float) are checked against the
+ * parameter schema at compile time, and the invoker that unpacks
+ * RuntimeParams into the handler arguments is generated per handler, so
+ * nothing is formatted or parsed when an action runs.
+ *
+ * @code
+ * constexpr CapabilityParamDef kBlinkParams[] = {
+ *     {"count", ParamType::INT, true, 1, 10, "Number of blinks"},
+ *     {"period", ParamType::FLOAT, false, 0, 5, "Seconds per blink"}};
+ * constexpr CapabilityDef kBlink("blink", "Blink LED", "", "output",
+ *                                kBlinkParams);
+ *
+ * void onBlink(int32_t count, float period) { ... }
+ *
+ * controller.registerCapability<kBlink>(onBlink);
+ * @endcode
+ */
+#pragma once
+#include "Types.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+namespace W4RP {
+
+/**
+ * @struct CapabilityParamDef
+ * @brief Parameter schema entry (constant data)
+ */
+struct CapabilityParamDef {
+  const char *name;
+  ParamType type;
+  bool required;
+  int16_t min;
+  int16_t max;
+  const char *description;
+};
+
+/**
+ * @struct CapabilityDef
+ * @brief Capability description (constant data)
+ */
+struct CapabilityDef {
+  const char *id;
+  const char *label;
+  const char *description;
+  const char *category;
+  const CapabilityParamDef *params;
+  uint8_t paramCount;
+
+  constexpr CapabilityDef(const char *id, const char *label,
+                          const char *description, const char *category)
+      : id(id), label(label), description(description), category(category),
+        params(nullptr), paramCount(0) {}
+
+  template <size_t N>
+  constexpr CapabilityDef(const char *id, const char *label,
+                          const char *description, const char *category,
+                          const CapabilityParamDef (&params)[N])
+      : id(id), label(label), description(description), category(category),
+        params(params), paramCount(N) {
+    static_assert(N <= 0xFF, "Too many capability parameters");
+  }
+
+  /// @brief Runtime form (for definitions built from CapabilityMeta)
+  constexpr CapabilityDef(const char *id, const char *label,
+                          const char *description, const char *category,
+                          const CapabilityParamDef *params, uint8_t count)
+      : id(id), label(label), description(description), category(category),
+        params(params), paramCount(count) {}
+};
+
+#ifndef W4RP_MAX_CAPABILITIES
+#define W4RP_MAX_CAPABILITIES 32 ///< Static-capacity builds only
+#endif
+
+/// Profile capability list (registration order)
+using CapabilityList =
+    CapacityVector<const CapabilityDef *, W4RP_MAX_CAPABILITIES>;
+
+/// Runs one action: receives its parameters as parsed from the ruleset.
+/// Wide enough to wrap a CapabilityHandler (ParamMap registrations).
+using ActionInvoker =
+    InplaceFunction<void(const ActionArgs &), sizeof(CapabilityHandler)>;
+
+namespace detail {
+
+/// Handler argument type → schema type + unpacking.
+/// Unsupported argument types fail to compile (no definition).
+template <typename T, typename Enable = void> struct ParamTraits;
+
+template <> struct ParamTraits<bool> {
+  static constexpr ParamType type = ParamType::BOOL;
+  static bool get(const ActionArgs &args, size_t i) {
+    const RuntimeParam *p = args.at(i);
+    if (!p)
+      return false;
+    return p->type == ParamType::FLOAT ? p->floatVal != 0.0f : p->intVal != 0;
+  }
+};
+
+template <> struct ParamTraits<float> {
+  static constexpr ParamType type = ParamType::FLOAT;
+  static float get(const ActionArgs &args, size_t i) {
+    const RuntimeParam *p = args.at(i);
+    if (!p)
+      return 0.0f;
+    return p->type == ParamType::FLOAT ? p->floatVal : (float)p->intVal;
+  }
+};
+
+template <> struct ParamTraits<const char *> {
+  static constexpr ParamType type = ParamType::STRING;
+  static const char *get(const ActionArgs &args, size_t i) {
+    const RuntimeParam *p = args.at(i);
+    return p ? args.text(*p) : "";
+  }
+};
+
+template <typename T>
+struct ParamTraits<T, typename std::enable_if<
+                          std::is_integral<T>::value &&
+                          !std::is_same<T, bool>::value>::type> {
+  static constexpr ParamType type = ParamType::INT;
+  static T get(const ActionArgs &args, size_t i) {
+    const RuntimeParam *p = args.at(i);
+    if (!p)
+      return 0;
+    return (T)(p->type == ParamType::FLOAT ? (int32_t)p->floatVal : p->intVal);
+  }
+};
+
+template <typename T>
+using ArgType = typename std::remove_cv<
+    typename std::remove_reference<T>::type>::type;
+
+/// Handler signature → argument list
+template <typename... A> struct ArgList {
+  static constexpr size_t count = sizeof...(A);
+};
+
+template <typename F>
+struct HandlerTraits : HandlerTraits<decltype(&F::operator())> {};
+template <typename R, typename... A> struct HandlerTraits<R (*)(A...)> {
+  using Args = ArgList<ArgType<A>...>;
+};
+template <typename R, typename... A> struct HandlerTraits<R(A...)> {
+  using Args = ArgList<ArgType<A>...>;
+};
+template <typename C, typename R, typename... A>
+struct HandlerTraits<R (C::*)(A...)> {
+  using Args = ArgList<ArgType<A>...>;
+};
+template <typename C, typename R, typename... A>
+struct HandlerTraits<R (C::*)(A...) const> {
+  using Args = ArgList<ArgType<A>...>;
+};
+
+/// Compile-time schema comparison (C++11 constexpr: recursion only)
+template <typename... A> struct SchemaCheck;
+template <> struct SchemaCheck<> {
+  static constexpr bool matches(const CapabilityParamDef *, size_t) {
+    return true;
+  }
+};
+template <typename T, typename... Rest> struct SchemaCheck<T, Rest...> {
+  static constexpr bool matches(const CapabilityParamDef *params, size_t i) {
+    return params[i].type == ParamTraits<T>::type &&
+           SchemaCheck<Rest...>::matches(params, i + 1);
+  }
+};
+
+template <size_t... I> struct IndexList {};
+template <size_t N, size_t... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndexList<0, I...> {
+  using type = IndexList<I...>;
+};
+
+/// Missing (optional) trailing params unpack as 0 / false / ""
+template <typename F, typename... A, size_t... I>
+void invoke(F &handler, const ActionArgs &args, ArgList<A...>,
+            IndexList<I...>) {
+  handler(ParamTraits<A>::get(args, I)...);
+}
+
+template <typename... A>
+constexpr bool matchesSchema(const CapabilityDef &def, ArgList<A...>) {
+  return def.paramCount == sizeof...(A) &&
+         SchemaCheck<A...>::matches(def.params, 0);
+}
+
+} // namespace detail
+
+/**
+ * @brief Build the invoker for a typed handler
+ * Fails to compile if the handler's arguments do not match Def's schema
+ * (count and ParamType, in order).
+ * @tparam Def Capability definition (constexpr, namespace scope)
+ * @param handler Function, lambda or functor
+ */
+template <const CapabilityDef &Def, typename F>
+ActionInvoker makeInvoker(F handler) {
+  using Args = typename detail::HandlerTraits<F>::Args;
+  static_assert(Args::count == Def.paramCount,
+                "Handler argument count does not match the capability schema");
+  static_assert(detail::matchesSchema(Def, Args()),
+                "Handler argument types do not match the capability schema");
+
+  return [handler](const ActionArgs &args) mutable {
+    detail::invoke(handler, args, Args(),
+                   typename detail::MakeIndexList<Args::count>::type());
+  };
+}
+
+} // namespace W4RP
@@ -0,0 +1,101 @@
+/**
+ * @file ConditionKernel.cpp
+ * @brief CORE:ConditionKernel - Batched condition comparisons implementation
+ */
+
+#include "ConditionKernel.h"
+#include <cmath>
+
+namespace W4RP {
+namespace ConditionKernel {
+
+// OR the low m bits of word into bits at position pos (may span two words)
+static void orBits(uint32_t *bits, size_t pos, uint32_t word, size_t m) {
+  size_t shift = pos & 31;
+  bits[pos >> 5] |= word << shift;
+  if (shift != 0 && shift + m > 32)
+    bits[(pos >> 5) + 1] |= word >> (32 - shift);
+}
+
+// Bit j of a result word. A table rather than 1u << j: no variable shift
+// per condition (and a loop an -O3 host build can still vectorize).
+static const uint32_t kBit[32] = {
+    1u << 0,  1u << 1,  1u << 2,  1u << 3,  1u << 4,  1u << 5,  1u << 6,
+    1u << 7,  1u << 8,  1u << 9,  1u << 10, 1u << 11, 1u << 12, 1u << 13,
+    1u << 14, 1u << 15, 1u << 16, 1u << 17, 1u << 18, 1u << 19, 1u << 20,
+    1u << 21, 1u << 22, 1u << 23, 1u << 24, 1u << 25, 1u << 26, 1u << 27,
+    1u << 28, 1u << 29, 1u << 30, 1u << 31};
+
+// One operator over the whole run, 32 conditions per result word. The
+// inner loop has no branches: the result is a mask, not a select.
+template <typename T, typename Cmp>
+static void run(Cmp cmp, const T *values, const T *value1, const T *value2,
+                size_t n, uint32_t *bits, size_t first) {
+  for (size_t base = 0; base < n; base += 32) {
+    size_t m = (n - base < 32) ? n - base : 32;
+    const T *v = values + base;
+    const T *a = value1 + base;
+    const T *b = value2 + base;
+
+    uint32_t word = 0;
+    for (size_t j = 0; j < m; j++)
+      word |= kBit[j] & (0u - (uint32_t)cmp(v[j], a[j], b[j]));
+
+    orBits(bits, first + base, word, m);
+  }
+}
+
+void compare(Operation op, const float *values, const float *value1,
+             const float *value2, size_t n, uint32_t *bits, size_t first) {
+  switch (op) {
+  case Operation::EQ:
+    run([](float v, float a, float) { return fabsf(v - a) < EPSILON; },
+        values, value1, value2, n, bits, first);
+    break;
+  case Operation::NE:
+    run([](float v, float a, float) { return fabsf(v - a) >= EPSILON; },
+        values, value1, value2, n, bits, first);
+    break;
+  case Operation::GT:
+    run([](float v, float a, float) { return v > a; }, values, value1, value2,
+        n, bits, first);
+    break;
+  case Operation::GE:
+    run([](float v, float a, float) { return v >= a; }, values, value1,
+        value2, n, bits, first);
+    break;
+  case Operation::LT:
+    run([](float v, float a, float) { return v < a; }, values, value1, value2,
+        n, bits, first);
+    break;
+  case Operation::LE:
+    run([](float v, float a, float) { return v <= a; }, values, value1,
+        value2, n, bits, first);
+    break;
+  case Operation::WITHIN:
+    // & not &&: both sides always evaluated, no branch
+    run([](float v, float a, float b) { return (v >= a) & (v <= b); }, values,
+        value1, value2, n, bits, first);
+    break;
+  case Operation::OUTSIDE:
+    run([](float v, float a, float b) { return (v < a) | (v > b); }, values,
+        value1, value2, n, bits, first);
+    break;
+  default:
+    break;
+  }
+}
+
+void compareRaw(bool inside, const int64_t *values, const int64_t *lo,
+                const int64_t *hi, size_t n, uint32_t *bits, size_t first) {
+  if (inside) {
+    run([](int64_t v, int64_t a, int64_t b) { return (v >= a) & (v <= b); },
+        values, lo, hi, n, bits, first);
+  } else {
+    run([](int64_t v, int64_t a, int64_t b) { return (v < a) | (v > b); },
+        values, lo, hi, n, bits, first);
+  }
+}
+
+} // namespace ConditionKernel
+} // namespace W4RP
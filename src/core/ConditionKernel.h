@@ -0,0 +1,60 @@
+/**
+ * @file ConditionKernel.h
+ * @brief CORE:ConditionKernel - Batched condition comparisons
+ * @version 1.0.0
+ *
+ * Compares a run of conditions that share one operator against their
+ * signal values and sets the results in a bitset. The Engine stores
+ * conditions grouped by operator, so each group is a single call with no
+ * per-condition switch.
+ *
+ * The loops are branch-free scalar code over contiguous arrays. The gain
+ * over a per-condition switch comes from dropping the switch and the
+ * per-condition branches, not from SIMD: ESP32 has no vector unit GCC
+ * targets, and the Arduino -Os / -O2 builds do not vectorize them.
+ * HOLD is stateful and is evaluated by the Engine.
+ *
+ * Conditions whose thresholds map exactly onto raw integers are compiled to
+ * range tests on the undecoded value (compareRaw()), so they need no float
+ * conversion and compare large integers exactly.
+ */
+#pragma once
+#include "Types.h"
+
+namespace W4RP {
+namespace ConditionKernel {
+
+constexpr float EPSILON = 0.0001f; ///< EQ / NE tolerance
+
+/**
+ * @brief Compare n conditions with the same operator
+ * Bit (first + i) of bits is set when condition i holds; other bits are
+ * left unchanged (the bitset is only ORed into).
+ * @param op Operator (HOLD is not handled: sets nothing)
+ * @param values Signal value per condition
+ * @param value1 First threshold per condition
+ * @param value2 Second threshold per condition (WITHIN / OUTSIDE)
+ * @param n Condition count
+ * @param bits Bitset, 32 conditions per word
+ * @param first Bit position of condition 0
+ */
+void compare(Operation op, const float *values, const float *value1,
+             const float *value2, size_t n, uint32_t *bits, size_t first);
+
+/**
+ * @brief Raw-domain range tests (see RuntimeCondition::rawLo / rawHi)
+ * Sets bit (first + i) when lo[i] <= values[i] <= hi[i] (inside), or when
+ * values[i] is outside that range (inside false).
+ * @param inside Range test polarity, the same for the whole run
+ * @param values Raw signal value per condition
+ * @param lo Lower bounds
+ * @param hi Upper bounds
+ * @param n Condition count
+ * @param bits Bitset, 32 conditions per word
+ * @param first Bit position of condition 0
+ */
+void compareRaw(bool inside, const int64_t *values, const int64_t *lo,
+                const int64_t *hi, size_t n, uint32_t *bits, size_t first);
+
+} // namespace ConditionKernel
+} // namespace W4RP
@@ -4,6 +4,7 @@
  */
 
 #include "Engine.h"
+#include "ConditionKernel.h"
 #include "Protocol.h"
 #include <algorithm>
 #include <cmath>
@@ -42,11 +43,123 @@ static uint64_t extractBits(const uint8_t data[8], uint16_t start, uint8_t len,
   return result;
 }
 
+/// Same CAN bits and interpretation => same raw value
+static bool sameBits(const RuntimeSignal &a, const RuntimeSignal &b) {
+  return a.canId == b.canId && a.startBit == b.startBit &&
+         a.bitLength == b.bitLength && a.bigEndian == b.bigEndian &&
+         a.isSigned == b.isSigned;
+}
+
+/// Entries for canId in an index sorted by canId: [first, last)
+template <typename Ref>
+static void findRange(const Ref *begin, const Ref *end, uint32_t canId,
+                      const Ref *&first, const Ref *&last) {
+  first = std::lower_bound(
+      begin, end, canId,
+      [](const Ref &ref, uint32_t id) { return ref.canId < id; });
+  last = first;
+  while (last != end && last->canId == canId)
+    ++last;
+}
+
+template <typename Ref> static bool byCanId(const Ref &a, const Ref &b) {
+  return a.canId != b.canId ? a.canId < b.canId : a.idx < b.idx;
+}
+
+/// physical = raw * factor + offset is exact integer math: whole factor
+/// and offset, raw small enough that the products stay far inside int64
+static bool hasIntegerScaling(const RuntimeSignal &sig) {
+  return sig.bitLength <= 32 && sig.factor >= 1.0f &&
+         sig.factor <= 65536.0f && sig.factor == floorf(sig.factor) &&
+         sig.offset == floorf(sig.offset) && fabsf(sig.offset) <= 2.0e9f;
+}
+
+/// Raw value where the physical value equals t (may be fractional)
+static double rawPoint(const RuntimeSignal &sig, float t) {
+  return ((double)t - sig.offset) / sig.factor;
+}
+
+// Past any 32-bit raw value: keeps open-ended bounds simple
+static const int64_t RAW_MIN = -(1LL << 40);
+static const int64_t RAW_MAX = 1LL << 40;
+
+static int64_t clampRaw(double r) {
+  return r < (double)RAW_MIN ? RAW_MIN
+                             : (r > (double)RAW_MAX ? RAW_MAX : (int64_t)r);
+}
+
+/**
+ * Rewrite a condition as a raw range test, if that is exact: holds when
+ * rawLo <= raw <= rawHi (rawInside) or when raw is outside that range.
+ * An empty range (lo > hi) makes "inside" never and "outside" always hold.
+ */
+static bool toRawDomain(const RuntimeSignal &sig, RuntimeCondition &cond) {
+  if (!hasIntegerScaling(sig))
+    return false;
+
+  bool ranged = cond.operation == Operation::WITHIN ||
+                cond.operation == Operation::OUTSIDE;
+  if (cond.operation != Operation::HOLD && !std::isfinite(cond.value1))
+    return false;
+  if (ranged && !std::isfinite(cond.value2))
+    return false;
+
+  double a = rawPoint(sig, cond.value1);
+  int64_t lo = RAW_MIN;
+  int64_t hi = RAW_MAX;
+  bool inside = true;
+
+  switch (cond.operation) {
+  case Operation::EQ:
+  case Operation::NE:
+    // Fractional thresholds keep the epsilon comparison
+    if (cond.value1 != floorf(cond.value1))
+      return false;
+    lo = clampRaw(ceil(a)); // Empty when t is not reachable
+    hi = clampRaw(floor(a));
+    inside = cond.operation == Operation::EQ;
+    break;
+  case Operation::GT:
+    lo = clampRaw(floor(a) + 1);
+    break;
+  case Operation::GE:
+    lo = clampRaw(ceil(a));
+    break;
+  case Operation::LT:
+    hi = clampRaw(ceil(a) - 1);
+    break;
+  case Operation::LE:
+    hi = clampRaw(floor(a));
+    break;
+  case Operation::WITHIN:
+  case Operation::OUTSIDE:
+    lo = clampRaw(ceil(a));
+    hi = clampRaw(floor(rawPoint(sig, cond.value2)));
+    inside = cond.operation == Operation::WITHIN;
+    break;
+  case Operation::HOLD: {
+    // Active while the physical value is not 0
+    double zero = rawPoint(sig, 0.0f);
+    lo = clampRaw(ceil(zero));
+    hi = clampRaw(floor(zero));
+    inside = false;
+    break;
+  }
+  default:
+    return false;
+  }
+
+  cond.rawDomain = true;
+  cond.rawInside = inside;
+  cond.rawLo = lo;
+  cond.rawHi = hi;
+  return true;
+}
+
 Engine::Engine() {}
 
-float Engine::decodeSignal(const RuntimeSignal &sig, const uint8_t *data) {
+int64_t Engine::decodeRaw(const RuntimeSignal &sig, const uint8_t *data) {
   uint64_t raw = extractBits(data, sig.startBit, sig.bitLength, sig.bigEndian);
-  float val;
 
   if (sig.isSigned) {
     if (sig.bitLength > 0 && sig.bitLength < 64) {
@@ -54,203 +167,483 @@ float Engine::decodeSignal(const RuntimeSignal &sig, const uint8_t *data) {
         raw |= (~0ULL << sig.bitLength);
       }
     }
-    val = (float)(int64_t)raw;
-  } else {
-    val = (float)raw;
   }
 
-  return val * sig.factor + sig.offset;
+  return (int64_t)raw;
+}
+
+float Engine::decodeSignal(const RuntimeSignal &sig, const uint8_t *data) {
+  return scaleRaw(sig, decodeRaw(sig, data));
 }
 
 bool Engine::loadRuleset(const uint8_t *data, size_t len) {
-  std::vector<RuntimeSignal> newSignals;
-  std::vector<RuntimeCondition> newConditions;
-  std::vector<RuntimeAction> newActions;
-  std::vector<RuntimeRule> newRules;
+  unknownCapability_ = -1;
+  if (!fitsCapacity(rulesetBinary_, len))
+    return false;
 
-  if (!Protocol::parseRules(data, len, newSignals, newConditions, newActions,
-                            newRules)) {
+  if (!Protocol::parseRules(data, len, pendingSignals_, pendingConditions_,
+                            pendingActions_, pendingParams_, pendingRules_,
+                            pendingStrings_)) {
     return false;
   }
 
   // Validate capabilities BEFORE committing (preserve existing rules on
   // failure)
-  for (const RuntimeAction &action : newActions) {
-    if (handlers_.find(action.capabilityId) == handlers_.end()) {
-      unknownCapability_ = action.capabilityId;
+  for (RuntimeAction &action : pendingActions_) {
+    int idx = findCapability(pendingStrings_.get(action.capabilityStrId));
+    if (idx < 0) {
+      unknownCapability_ = action.capabilityStrId;
       return false;
     }
+    action.capabilityIdx = idx;
   }
-  unknownCapability_ = ""; // Clear on success
 
-  // Swap atomically (only after validation passes)
-  signals_ = std::move(newSignals);
-  conditions_ = std::move(newConditions);
-  actions_ = std::move(newActions);
-  rules_ = std::move(newRules);
-
-  // Build signal lookup map
-  signalMap_.clear();
-  for (RuntimeSignal &sig : signals_) {
-    signalMap_[sig.canId].push_back(&sig);
-  }
+  // Commit (only after validation passes)
+  signals_ = std::move(pendingSignals_);
+  compileConditions();
+  actions_ = std::move(pendingActions_);
+  params_ = std::move(pendingParams_);
+  rules_ = std::move(pendingRules_);
+  strings_ = std::move(pendingStrings_);
+  pendingSignals_.clear();
+  pendingConditions_.clear();
+  pendingActions_.clear();
+  pendingParams_.clear();
+  pendingRules_.clear();
+  pendingStrings_.clear();
+
+  indexSignals();
+  linkDebugSignals();
 
   // Store binary for persistence
   rulesetBinary_.assign(data, data + len);
   rulesetCRC_ = Protocol::calculateCRC32(data, len);
+  generation_++;
 
   return true;
 }
 
+size_t Engine::conditionGroup(const RuntimeCondition &cond) {
+  if (cond.operation == Operation::HOLD)
+    return GROUP_HOLD;
+  if (cond.rawDomain)
+    return cond.rawInside ? GROUP_RAW_WITHIN : GROUP_RAW_OUTSIDE;
+  return static_cast<size_t>(cond.operation);
+}
+
+void Engine::compileConditions() {
+  // Rule masks are 32-bit: conditions past 32 can never be referenced
+  size_t n = pendingConditions_.size() < 32 ? pendingConditions_.size() : 32;
+  uint8_t newIdx[32];
+
+  for (size_t i = 0; i < n; i++) {
+    RuntimeCondition &cond = pendingConditions_[i];
+    toRawDomain(signals_[cond.signalIdx], cond);
+  }
+
+  // Stable counting sort by kernel group
+  conditions_.clear();
+  for (size_t g = 0; g < GROUP_COUNT; g++) {
+    conditionGroups_[g] = conditions_.size();
+    for (size_t i = 0; i < n; i++) {
+      if (conditionGroup(pendingConditions_[i]) == g) {
+        newIdx[i] = conditions_.size();
+        conditions_.push_back(pendingConditions_[i]);
+      }
+    }
+  }
+  conditionGroups_[GROUP_COUNT] = conditions_.size();
+
+  // Renumber the rules' condition bits to the new order
+  for (RuntimeRule &rule : pendingRules_) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (rule.conditionMask & (1u << i))
+        mask |= 1u << newIdx[i];
+    }
+    rule.conditionMask = mask;
+  }
+
+  // Only signals that a float condition reads get scaled on update
+  signalState_.reset(signals_.size());
+  conditionSignal_.clear();
+  conditionValue1_.clear();
+  conditionValue2_.clear();
+  conditionRawLo_.clear();
+  conditionRawHi_.clear();
+  for (const RuntimeCondition &cond : conditions_) {
+    conditionSignal_.push_back(cond.signalIdx);
+    conditionValue1_.push_back(cond.value1);
+    conditionValue2_.push_back(cond.value2);
+    conditionRawLo_.push_back(cond.rawLo);
+    conditionRawHi_.push_back(cond.rawHi);
+    if (!cond.rawDomain)
+      signalState_.setScaled(cond.signalIdx);
+  }
+  conditionInput_.assign(conditions_.size(), 0.0f);
+  conditionRawInput_.assign(conditions_.size(), 0);
+}
+
+void Engine::indexSignals() {
+  signalIndex_.clear();
+  for (size_t i = 0; i < signals_.size(); i++)
+    signalIndex_.push_back({signals_[i].canId, (uint16_t)i});
+  std::sort(signalIndex_.begin(), signalIndex_.end(), byCanId<SignalRef>);
+
+  // One payload slot per CAN ID, in the same (sorted) order
+  frameSlots_.clear();
+  signalSlot_.assign(signals_.size(), 0);
+  decodedVersion_.assign(signals_.size(), 0);
+  for (const SignalRef &ref : signalIndex_) {
+    if (frameSlots_.empty() || frameSlots_.back().canId != ref.canId) {
+      FrameSlot slot;
+      slot.canId = ref.canId;
+      frameSlots_.push_back(slot);
+    }
+    signalSlot_[ref.idx] = frameSlots_.size() - 1;
+  }
+}
+
 void Engine::clearRuleset() {
   signals_.clear();
   conditions_.clear();
+  conditionSignal_.clear();
+  conditionValue1_.clear();
+  conditionValue2_.clear();
+  conditionRawLo_.clear();
+  conditionRawHi_.clear();
+  conditionInput_.clear();
+  conditionRawInput_.clear();
+  memset(conditionGroups_, 0, sizeof(conditionGroups_));
   actions_.clear();
+  params_.clear();
   rules_.clear();
-  signalMap_.clear();
+  strings_.clear();
+  signalState_.reset(0);
+  signalIndex_.clear();
+  frameSlots_.clear();
+  signalSlot_.clear();
+  decodedVersion_.clear();
+  linkDebugSignals();
   rulesetBinary_.clear();
   rulesetCRC_ = 0;
   rulesTriggered_ = 0;
+  generation_++;
+}
+
+static ParamType paramTypeFromName(const String &type) {
+  if (type == "float")
+    return ParamType::FLOAT;
+  if (type == "string")
+    return ParamType::STRING;
+  if (type == "bool")
+    return ParamType::BOOL;
+  return ParamType::INT;
 }
 
-void Engine::registerCapability(const String &id, CapabilityHandler handler) {
-  handlers_[id] = handler;
+Engine::OwnedCapability::OwnedCapability(const String &id,
+                                         const CapabilityMeta &m)
+    : meta(m), def(nullptr, nullptr, nullptr, nullptr) {
+  meta.id = id;
+  for (const CapabilityParamMeta &p : meta.params) {
+    params.push_back({p.name.c_str(), paramTypeFromName(p.type), p.required,
+                      (int16_t)p.min, (int16_t)p.max, p.description.c_str()});
+  }
+  def = CapabilityDef(meta.id.c_str(), meta.label.c_str(),
+                      meta.description.c_str(), meta.category.c_str(),
+                      params.data(), (uint8_t)params.size());
 }
 
-void Engine::registerCapability(const String &id, CapabilityHandler handler,
+// String handlers get the parameters as "p0", "p1", ... text
+static ActionInvoker paramMapInvoker(CapabilityHandler handler) {
+  return [handler](const ActionArgs &args) {
+    ParamMap params;
+    for (size_t i = 0; i < args.count; i++) {
+      const RuntimeParam &p = args.params[i];
+      char key[16];
+      snprintf(key, sizeof(key), "p%d", (int)i);
+
+      if (p.type == ParamType::STRING) {
+        params[String(key)] = args.text(p);
+      } else if (p.type == ParamType::FLOAT) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%.4f", p.floatVal);
+        params[String(key)] = String(buf);
+      } else {
+        params[String(key)] = String(p.intVal);
+      }
+    }
+    handler(params);
+  };
+}
+
+bool Engine::registerCapability(const String &id, CapabilityHandler handler) {
+  Capability cap;
+  cap.owned.reset(new OwnedCapability(id, CapabilityMeta()));
+  cap.def = &cap.owned->def;
+  cap.invoke = paramMapInvoker(handler);
+  cap.listed = false;
+  return addCapability(std::move(cap));
+}
+
+bool Engine::registerCapability(const String &id, CapabilityHandler handler,
                                 const CapabilityMeta &meta) {
-  handlers_[id] = handler;
-  capabilityMeta_[id] = meta;
+  Capability cap;
+  cap.owned.reset(new OwnedCapability(id, meta));
+  cap.def = &cap.owned->def;
+  cap.invoke = paramMapInvoker(handler);
+  cap.listed = true;
+  return addCapability(std::move(cap));
+}
+
+bool Engine::registerCapability(const CapabilityDef &def,
+                                ActionInvoker invoker) {
+  Capability cap;
+  cap.def = &def;
+  cap.invoke = std::move(invoker);
+  cap.listed = true;
+  return addCapability(std::move(cap));
+}
+
+int Engine::findCapability(const char *id) const {
+  for (size_t i = 0; i < capabilities_.size(); i++) {
+    if (strcmp(capabilities_[i].def->id, id) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool Engine::addCapability(Capability &&cap) {
+  // Re-registering replaces in place: loaded actions keep their index
+  int idx = findCapability(cap.def->id);
+  if (idx >= 0) {
+    capabilities_[idx] = std::move(cap);
+  } else if (fitsCapacity(capabilities_, capabilities_.size() + 1)) {
+    capabilities_.push_back(std::move(cap));
+  } else {
+    Serial.printf("[Engine] Error: Capability '%s' not registered, "
+                  "W4RP_MAX_CAPABILITIES (%d) reached\n",
+                  cap.def->id, W4RP_MAX_CAPABILITIES);
+    return false;
+  }
+
+  profileCapabilities_.clear();
+  for (const Capability &c : capabilities_) {
+    if (c.listed)
+      profileCapabilities_.push_back(c.def);
+  }
+  generation_++;
+  return true;
 }
 
 void Engine::processCanFrame(const CanFrame &frame) {
   uint32_t now = millis();
-
-  // Update ruleset signals
-  auto it = signalMap_.find(frame.id);
-  if (it != signalMap_.end()) {
-    for (RuntimeSignal *sig : it->second) {
-      sig->lastValue = sig->value;
-      sig->value = decodeSignal(*sig, frame.data);
-      sig->lastUpdateMs = now;
-      sig->everSet = true;
+  const SignalRef *ref, *last;
+
+  if (W4RP_LAZY_DECODE) {
+    // Ruleset signals are decoded by refreshSignals()
+    const FrameSlot *slot = storeFrame(frame, now);
+
+    // Watch entries sharing a ruleset decode still sample every frame. The
+    // decode is stored with its slot version, so refreshSignals() skips it.
+    if (slot && debugMode_ && !rulesetDebugHead_.empty()) {
+      findRange(signalIndex_.data(),
+                signalIndex_.data() + signalIndex_.size(), frame.id, ref,
+                last);
+      for (; ref != last; ++ref) {
+        uint16_t i = ref->idx;
+        int16_t head = rulesetDebugHead_[i];
+        if (head < 0)
+          continue;
+        if (decodedVersion_[i] != slot->version) {
+          decodedVersion_[i] = slot->version;
+          const RuntimeSignal &sig = signals_[i];
+          int64_t raw = decodeRaw(sig, slot->data);
+          signalState_.set(i, raw, now);
+          if (signalState_.isScaled(i))
+            signalState_.value[i] = scaleRaw(sig, raw);
+        }
+        int64_t raw = signalState_.raw[i];
+        for (int16_t d = head; d >= 0; d = debugSignals_[d].nextLinked)
+          updateDebugSample(debugSignals_[d], raw);
+      }
+    }
+  } else {
+    // Update ruleset signals (and watch entries sharing their decode)
+    findRange(signalIndex_.data(), signalIndex_.data() + signalIndex_.size(),
+              frame.id, ref, last);
+    for (; ref != last; ++ref) {
+      uint16_t i = ref->idx;
+      const RuntimeSignal &sig = signals_[i];
+      int64_t raw = decodeRaw(sig, frame.data);
+      signalState_.set(i, raw, now);
+      if (signalState_.isScaled(i))
+        signalState_.value[i] = scaleRaw(sig, raw);
+
+      if (debugMode_ && i < rulesetDebugHead_.size()) {
+        for (int16_t d = rulesetDebugHead_[i]; d >= 0;
+             d = debugSignals_[d].nextLinked)
+          updateDebugSample(debugSignals_[d], raw);
+      }
     }
   }
 
-  // Update debug signals
+  // Update debug-only signals
   if (debugMode_) {
-    auto dit = debugSignalMap_.find(frame.id);
-    if (dit != debugSignalMap_.end()) {
-      for (size_t idx : dit->second) {
-        RuntimeSignal &sig = debugSignals_[idx];
-        sig.lastValue = sig.value;
-        sig.value = decodeSignal(sig, frame.data);
-        sig.lastUpdateMs = now;
-        sig.everSet = true;
-
-        // Push to dirty queue if changed
-        if (fabsf(sig.value - sig.lastDebugValue) > 0.01f) {
-          if (!debugDirtyFlags_[idx] && debugDirtyQueue_.size() < 64) {
-            debugDirtyFlags_[idx] = true;
-            debugDirtyQueue_.push_back(idx);
-          }
-        }
-      }
+    findRange(debugIndex_.data(), debugIndex_.data() + debugIndex_.size(),
+              frame.id, ref, last);
+    for (; ref != last; ++ref) {
+      int64_t raw = decodeRaw(debugSignals_[ref->idx].sig, frame.data);
+      for (int16_t d = ref->idx; d >= 0; d = debugSignals_[d].nextLinked)
+        updateDebugSample(debugSignals_[d], raw);
     }
   }
 }
 
-bool Engine::evaluateCondition(RuntimeCondition &cond, uint32_t nowMs) {
-  if (cond.signalIdx >= signals_.size())
-    return false;
+const FrameSlot *Engine::storeFrame(const CanFrame &frame, uint32_t nowMs) {
+  FrameSlot *end = frameSlots_.data() + frameSlots_.size();
+  FrameSlot *slot = std::lower_bound(
+      frameSlots_.data(), end, frame.id,
+      [](const FrameSlot &s, uint32_t id) { return s.canId < id; });
+  if (slot == end || slot->canId != frame.id)
+    return nullptr;
+
+  slot->rxMs = nowMs;
+  if (slot->version == 0 ||
+      memcmp(slot->data, frame.data, sizeof(slot->data)) != 0) {
+    memcpy(slot->data, frame.data, sizeof(slot->data));
+    if (++slot->version == 0) // 0 means "never received"
+      slot->version = 1;
+  }
+  return slot;
+}
 
-  RuntimeSignal &sig = signals_[cond.signalIdx];
-  if (!sig.everSet)
-    return false;
+void Engine::refreshSignals() {
+  for (size_t i = 0; i < signals_.size(); i++) {
+    const FrameSlot &slot = frameSlots_[signalSlot_[i]];
+    signalState_.updatedMs[i] = slot.rxMs;
+    if (slot.version == decodedVersion_[i])
+      continue; // Same bytes as the last decode (or nothing received)
+
+    decodedVersion_[i] = slot.version;
+    const RuntimeSignal &sig = signals_[i];
+    int64_t raw = decodeRaw(sig, slot.data);
+    signalState_.set(i, raw, slot.rxMs);
+    if (signalState_.isScaled(i))
+      signalState_.value[i] = scaleRaw(sig, raw);
+  }
+}
 
-  float val = sig.value;
-  constexpr float EPSILON = 0.0001f;
+void Engine::updateDebugSample(DebugSignal &dbg, int64_t raw) {
+  dbg.raw = raw;
+  dbg.sampled = true;
 
-  // Handle HOLD operation
-  if (cond.operation == Operation::HOLD) {
-    bool active = (fabsf(val) > EPSILON); // Fixed: use epsilon
-    if (active) {
-      if (!cond.holdActive) {
-        cond.holdActive = true;
-        cond.holdStartMs = nowMs;
-      }
-      return (nowMs - cond.holdStartMs) >= cond.holdMs;
+  // Accumulate for the current interval
+  if (dbg.aggCount == 0) {
+    dbg.aggMin = dbg.aggMax = dbg.aggSum = raw;
+  } else {
+    if (raw < dbg.aggMin)
+      dbg.aggMin = raw;
+    if (raw > dbg.aggMax)
+      dbg.aggMax = raw;
+    dbg.aggSum += raw;
+  }
+  dbg.aggCount++;
+}
+
+uint32_t Engine::evaluateConditions(uint32_t nowMs) {
+  if (W4RP_LAZY_DECODE)
+    refreshSignals();
+
+  size_t n = conditions_.size();
+
+  // Gather signal values into condition order (float or raw domain)
+  uint32_t valid = 0;
+  for (size_t k = 0; k < n; k++) {
+    uint8_t s = conditionSignal_[k];
+    conditionInput_[k] = signalState_.value[s];
+    conditionRawInput_[k] = signalState_.raw[s];
+    valid |= (uint32_t)signalState_.isValid(s) << k;
+  }
+
+  // One kernel call per group
+  uint32_t met = 0;
+  for (size_t g = 0; g < GROUP_HOLD; g++) {
+    size_t first = conditionGroups_[g];
+    size_t count = conditionGroups_[g + 1] - first;
+    if (count == 0)
+      continue;
+
+    if (g == GROUP_RAW_WITHIN || g == GROUP_RAW_OUTSIDE) {
+      ConditionKernel::compareRaw(g == GROUP_RAW_WITHIN,
+                                  conditionRawInput_.data() + first,
+                                  conditionRawLo_.data() + first,
+                                  conditionRawHi_.data() + first, count, &met,
+                                  first);
     } else {
-      cond.holdActive = false;
-      cond.holdStartMs = 0;
-      return false;
+      ConditionKernel::compare(static_cast<Operation>(g),
+                               conditionInput_.data() + first,
+                               conditionValue1_.data() + first,
+                               conditionValue2_.data() + first, count, &met,
+                               first);
     }
   }
 
-  // Standard operations
-  switch (cond.operation) {
-  case Operation::EQ:
-    return (fabsf(val - cond.value1) < EPSILON); // Fixed: use epsilon
-  case Operation::NE:
-    return (fabsf(val - cond.value1) >= EPSILON); // Fixed: use epsilon
-  case Operation::GT:
-    return (val > cond.value1);
-  case Operation::GE:
-    return (val >= cond.value1);
-  case Operation::LT:
-    return (val < cond.value1);
-  case Operation::LE:
-    return (val <= cond.value1);
-  case Operation::WITHIN:
-    return (val >= cond.value1 && val <= cond.value2);
-  case Operation::OUTSIDE:
-    return (val < cond.value1 || val > cond.value2);
-  default:
-    return false;
+  // HOLD keeps per-condition timers; never-received signals leave them as is
+  for (size_t k = conditionGroups_[GROUP_HOLD];
+       k < conditionGroups_[GROUP_HOLD + 1]; k++) {
+    if (!(valid & (1u << k)))
+      continue;
+
+    const RuntimeCondition &cond = conditions_[k];
+    int64_t raw = conditionRawInput_[k];
+    bool active =
+        cond.rawDomain
+            ? ((raw >= cond.rawLo && raw <= cond.rawHi) == cond.rawInside)
+            : fabsf(conditionInput_[k]) > ConditionKernel::EPSILON;
+    if (evaluateHold(conditions_[k], active, nowMs))
+      met |= 1u << k;
   }
+
+  return met & valid;
+}
+
+bool Engine::evaluateHold(RuntimeCondition &cond, bool active,
+                          uint32_t nowMs) {
+  if (active) {
+    if (!cond.holdActive) {
+      cond.holdActive = true;
+      cond.holdStartMs = nowMs;
+    }
+    return (nowMs - cond.holdStartMs) >= cond.holdMs;
+  }
+
+  cond.holdActive = false;
+  cond.holdStartMs = 0;
+  return false;
 }
 
 void Engine::executeAction(RuntimeAction &action) {
-  auto it = handlers_.find(action.capabilityId);
-  if (it == handlers_.end())
+  if (action.capabilityIdx >= capabilities_.size())
     return;
 
-  // Convert params to map
-  ParamMap params;
-  for (size_t i = 0; i < action.params.size(); i++) {
-    const RuntimeParam &p = action.params[i];
-    char key[16];
-    snprintf(key, sizeof(key), "p%d", (int)i);
-
-    if (p.type == ParamType::STRING) {
-      params[String(key)] = p.strVal;
-    } else if (p.type == ParamType::FLOAT) {
-      char buf[16];
-      snprintf(buf, sizeof(buf), "%.4f", p.floatVal);
-      params[String(key)] = String(buf);
-    } else {
-      params[String(key)] = String(p.intVal);
-    }
+  const Capability &cap = capabilities_[action.capabilityIdx];
+  if (cap.invoke) {
+    ActionArgs args = {params_.data() + action.paramStart, action.paramCount,
+                       &strings_};
+    cap.invoke(args);
   }
-
-  it->second(params);
 }
 
 void Engine::evaluateRules() {
   uint32_t nowMs = millis();
 
+  // Every condition once per pass, as a bitset
+  uint32_t met = evaluateConditions(nowMs);
+
   for (RuntimeRule &rule : rules_) {
-    // Evaluate all conditions in mask (AND logic)
-    bool allMet = true;
-
-    for (size_t c = 0; c < conditions_.size() && c < 32; c++) {
-      if (rule.conditionMask & (1 << c)) {
-        if (!evaluateCondition(conditions_[c], nowMs)) {
-          allMet = false;
-          break;
-        }
-      }
-    }
+    // All conditions in mask (AND logic)
+    bool allMet = (met & rule.conditionMask) == rule.conditionMask;
 
     // Track state change for debounce
     if (allMet != rule.lastConditionState) {
@@ -281,8 +674,7 @@ void Engine::evaluateRules() {
 }
 
 size_t Engine::loadDebugSignals(const String &definitions) {
-  std::vector<RuntimeSignal> newSignals;
-  std::map<uint32_t, std::vector<size_t>> newMap;
+  pendingDebugSignals_.clear();
 
   int start = 0;
   while (start < (int)definitions.length()) {
@@ -295,69 +687,222 @@ size_t Engine::loadDebugSignals(const String &definitions) {
 
     if (def.length() > 0) {
       // Parse: CanId:StartBit:BitLen:BE:Factor:Offset
+      //        [:IntervalMs:Deadband:Mode:Aggregate]
       int p1 = def.indexOf(':');
       int p2 = def.indexOf(':', p1 + 1);
       int p3 = def.indexOf(':', p2 + 1);
       int p4 = def.indexOf(':', p3 + 1);
       int p5 = def.indexOf(':', p4 + 1);
+      int p6 = def.indexOf(':', p5 + 1);
+      int p7 = def.indexOf(':', p6 + 1);
+      int p8 = def.indexOf(':', p7 + 1);
+      int p9 = def.indexOf(':', p8 + 1);
 
       if (p1 > 0 && p2 > p1 && p3 > p2 && p4 > p3 && p5 > p4) {
-        RuntimeSignal sig = {};
+        DebugSignal dbg = {};
+        RuntimeSignal &sig = dbg.sig;
         sig.canId = def.substring(0, p1).toInt();
         sig.startBit = def.substring(p1 + 1, p2).toInt();
         sig.bitLength = def.substring(p2 + 1, p3).toInt();
         sig.bigEndian = def.substring(p3 + 1, p4).toInt() != 0;
         sig.factor = def.substring(p4 + 1, p5).toFloat();
-        sig.offset = def.substring(p5 + 1).toFloat();
+        sig.offset = def.substring(p5 + 1, p6 > p5 ? p6 : def.length())
+                         .toFloat();
         sig.isSigned = false;
-        sig.lastDebugValue = -999999.9f;
 
-        size_t idx = newSignals.size();
-        newSignals.push_back(sig);
-        newMap[sig.canId].push_back(idx);
+        if (p6 > p5 && p7 > p6 && p8 > p7 && p9 > p8) {
+          SamplePolicy &pol = dbg.policy;
+          pol.minIntervalMs = def.substring(p6 + 1, p7).toInt();
+          pol.deadband = def.substring(p7 + 1, p8).toFloat();
+          pol.mode = def.substring(p8 + 1, p9).toInt() == 1
+                         ? SampleMode::PERIODIC
+                         : SampleMode::ON_CHANGE;
+          long agg = def.substring(p9 + 1).toInt();
+          pol.aggregate = (agg >= 0 && agg <= 3)
+                              ? static_cast<SampleAggregate>(agg)
+                              : SampleAggregate::LAST;
+        }
+
+        if (!fitsCapacity(pendingDebugSignals_,
+                          pendingDebugSignals_.size() + 1)) {
+          pendingDebugSignals_.clear();
+          return 0;
+        }
+        pendingDebugSignals_.push_back(dbg);
       }
     }
     start = comma + 1;
   }
 
-  debugSignals_ = std::move(newSignals);
-  debugSignalMap_ = std::move(newMap);
-  debugDirtyFlags_.assign(debugSignals_.size(), false);
-  debugDirtyQueue_.clear();
-  debugQueueHead_ = 0;
+  return installDebugSignals();
+}
+
+size_t Engine::loadDebugSignals(const uint8_t *data, size_t len) {
+  if (!Protocol::isWatchList(data, len)) {
+    return loadDebugSignals(String((const char *)data, len));
+  }
+
+  if (!Protocol::parseWatchList(data, len, pendingDebugSignals_)) {
+    pendingDebugSignals_.clear();
+    return 0;
+  }
+
+  return installDebugSignals();
+}
+
+size_t Engine::installDebugSignals() {
+  debugSignals_ = std::move(pendingDebugSignals_);
+  pendingDebugSignals_.clear();
+  linkDebugSignals();
+  debugCursor_ = 0;
+  debugKeyPending_ = true; // Client starts from zero baselines
   debugMode_ = true;
 
   return debugSignals_.size();
 }
 
+void Engine::linkDebugSignals() {
+  debugIndex_.clear();
+  rulesetDebugHead_.assign(debugSignals_.empty() ? 0 : signals_.size(), -1);
+
+  for (size_t d = 0; d < debugSignals_.size(); d++) {
+    DebugSignal &dbg = debugSignals_[d];
+    dbg.rulesetIdx = -1;
+    dbg.primaryIdx = -1;
+    dbg.nextLinked = -1;
+
+    // Prefer the ruleset decode: it runs whether or not debug is on
+    const SignalRef *ref, *last;
+    findRange(signalIndex_.data(), signalIndex_.data() + signalIndex_.size(),
+              dbg.sig.canId, ref, last);
+    for (; ref != last; ++ref) {
+      if (sameBits(signals_[ref->idx], dbg.sig)) {
+        dbg.rulesetIdx = ref->idx;
+        dbg.nextLinked = rulesetDebugHead_[ref->idx];
+        rulesetDebugHead_[ref->idx] = d;
+        break;
+      }
+    }
+    if (dbg.rulesetIdx >= 0)
+      continue;
+
+    // debugIndex_ is unsorted until the end: scan it
+    for (const SignalRef &p : debugIndex_) {
+      if (p.canId == dbg.sig.canId &&
+          sameBits(debugSignals_[p.idx].sig, dbg.sig)) {
+        DebugSignal &primary = debugSignals_[p.idx];
+        dbg.primaryIdx = p.idx;
+        dbg.nextLinked = primary.nextLinked;
+        primary.nextLinked = d;
+        break;
+      }
+    }
+    if (dbg.primaryIdx < 0)
+      debugIndex_.push_back({dbg.sig.canId, (uint16_t)d});
+  }
+
+  std::sort(debugIndex_.begin(), debugIndex_.end(), byCanId<SignalRef>);
+}
+
 void Engine::clearDebugSignals() {
   debugSignals_.clear();
-  debugSignalMap_.clear();
-  debugDirtyFlags_.clear();
-  debugDirtyQueue_.clear();
-  debugQueueHead_ = 0;
+  debugIndex_.clear();
+  rulesetDebugHead_.clear();
+  debugCursor_ = 0;
+  debugKeyPending_ = false;
   debugMode_ = false;
 }
 
-bool Engine::popDirtyDebugSignal(RuntimeSignal &outSignal) {
-  if (debugQueueHead_ >= debugDirtyQueue_.size()) {
-    // Queue exhausted - reset
-    if (debugQueueHead_ > 0) {
-      debugDirtyQueue_.clear();
-      debugQueueHead_ = 0;
-    }
-    return false;
+void Engine::resyncDebugSignals() {
+  for (DebugSignal &dbg : debugSignals_) {
+    dbg.lastSentRaw = 0;
+    dbg.sent = false;
+  }
+  debugKeyPending_ = true;
+}
+
+int64_t Engine::sampleValue(const DebugSignal &dbg) const {
+  if (dbg.aggCount == 0)
+    return dbg.raw;
+
+  switch (dbg.policy.aggregate) {
+  case SampleAggregate::MIN:
+    return dbg.aggMin;
+  case SampleAggregate::MAX:
+    return dbg.aggMax;
+  case SampleAggregate::AVG: {
+    // Round half away from zero
+    int64_t n = dbg.aggCount;
+    int64_t sum = dbg.aggSum;
+    return (sum >= 0) ? (sum + n / 2) / n : (sum - n / 2) / n;
+  }
+  default:
+    return dbg.raw;
   }
+}
+
+bool Engine::isDebugDue(const DebugSignal &dbg, int64_t value,
+                        uint32_t nowMs) const {
+  if (!dbg.sampled)
+    return false;
+  if (!dbg.sent)
+    return true;
+  if (nowMs - dbg.lastSentMs < dbg.policy.minIntervalMs)
+    return false;
 
-  size_t idx = debugDirtyQueue_[debugQueueHead_++];
-  if (idx < debugSignals_.size()) {
-    debugDirtyFlags_[idx] = false;
-    outSignal = debugSignals_[idx];
-    debugSignals_[idx].lastDebugValue = debugSignals_[idx].value;
+  if (dbg.policy.mode == SampleMode::PERIODIC)
     return true;
+
+  if (value == dbg.lastSentRaw)
+    return false;
+  float delta = scaleRaw(dbg.sig, value) - scaleRaw(dbg.sig, dbg.lastSentRaw);
+  return fabsf(delta) > dbg.policy.deadband;
+}
+
+size_t Engine::buildDebugFrame(uint8_t *out, size_t maxLen, uint8_t seq) {
+  size_t n = debugSignals_.size();
+  if (n == 0 || maxLen <= DebugFrameWriter::HEADER_SIZE)
+    return 0;
+
+  uint32_t nowMs = millis();
+  DebugFrameWriter writer(out, maxLen, seq,
+                          debugKeyPending_ ? WBP_DEBUG_FLAG_KEY : 0);
+
+  if (debugCursor_ >= n)
+    debugCursor_ = 0;
+
+  // Round-robin from where the last frame stopped: when the budget is
+  // short, every due signal gets a turn before any is served twice
+  for (size_t scanned = 0; scanned < n; scanned++) {
+    DebugSignal &dbg = debugSignals_[debugCursor_];
+    int64_t value = sampleValue(dbg);
+
+    if (isDebugDue(dbg, value, nowMs)) {
+      if (!writer.add((uint16_t)debugCursor_, value - dbg.lastSentRaw))
+        break; // Frame full - resume here next time
+
+      dbg.lastSentRaw = value;
+      dbg.lastSentMs = nowMs;
+      dbg.sent = true;
+      dbg.windowStartMs = nowMs;
+      dbg.aggCount = 0;
+    } else if (nowMs - dbg.windowStartMs >= dbg.policy.minIntervalMs) {
+      // Nothing to send for this interval: start the next one anyway, or
+      // a MIN / MAX / AVG that matches the last sent value would hold
+      // back every later sample
+      dbg.windowStartMs = nowMs;
+      dbg.aggCount = 0;
+    }
+
+    debugCursor_ = (debugCursor_ + 1 == n) ? 0 : debugCursor_ + 1;
   }
 
-  return false;
+  // A key frame is sent even when empty so the client resets baselines
+  if (writer.count() == 0 && !debugKeyPending_)
+    return 0;
+
+  debugKeyPending_ = false;
+  return writer.size();
 }
 
 } // namespace W4RP
@@ -8,8 +8,10 @@
  */
 #pragma once
 #include "../interfaces/CAN.h"
+#include "Capability.h"
 #include "Types.h"
 #include <map>
+#include <memory>
 #include <vector>
 
 namespace W4RP {
@@ -33,15 +35,18 @@ public:
 
   /**
    * @brief Get capability that caused load failure
-   * @return Unknown capability ID or empty
+   * @return Unknown capability ID or empty (valid until the next load)
    */
-  String getUnknownCapability() const { return unknownCapability_; }
+  const char *getUnknownCapability() const {
+    return unknownCapability_ < 0 ? ""
+                                  : pendingStrings_.get(unknownCapability_);
+  }
 
   /// @brief Clear all rules and signals
   void clearRuleset();
 
   /// @brief Get ruleset binary for persistence
-  const std::vector<uint8_t> &getRulesetBinary() const {
+  const RulesetBinary &getRulesetBinary() const {
     return rulesetBinary_;
   }
 
@@ -52,25 +57,37 @@ public:
    * @brief Register capability handler
    * @param id Capability ID
    * @param handler Callback function
+   * @return false if W4RP_MAX_CAPABILITIES is reached (static capacity)
    */
-  void registerCapability(const String &id, CapabilityHandler handler);
+  bool registerCapability(const String &id, CapabilityHandler handler);
 
   /**
    * @brief Register capability with metadata
    * @param id Capability ID
    * @param handler Callback function
-   * @param meta Capability metadata
+   * @param meta Capability metadata (copied; prefer a CapabilityDef)
+   * @return false if W4RP_MAX_CAPABILITIES is reached (static capacity)
    */
-  void registerCapability(const String &id, CapabilityHandler handler,
+  bool registerCapability(const String &id, CapabilityHandler handler,
                           const CapabilityMeta &meta);
 
-  /// @brief Get registered capabilities
-  const std::map<String, CapabilityMeta> &getCapabilities() const {
-    return capabilityMeta_;
+  /**
+   * @brief Register capability from a constant definition
+   * @param def Definition, must outlive the engine (constexpr data)
+   * @param invoker Built by makeInvoker<Def>()
+   * @return false if W4RP_MAX_CAPABILITIES is reached (static capacity)
+   */
+  bool registerCapability(const CapabilityDef &def, ActionInvoker invoker);
+
+  /// @brief Capabilities listed in the profile, in registration order
+  const CapabilityList &getCapabilities() const {
+    return profileCapabilities_;
   }
 
   /**
    * @brief Process received CAN frame
+   * With W4RP_LAZY_DECODE the payload is only stored; ruleset signals are
+   * decoded by evaluateRules(), and only if the bytes changed.
    * @param frame CAN frame from bus
    */
   void processCanFrame(const CanFrame &frame);
@@ -81,19 +98,43 @@ public:
   /**
    * @brief Load debug signal definitions
    * @param definitions Comma-separated signal specs
+   * (CanId:StartBit:BitLen:BE:Factor:Offset[:IntervalMs:Deadband:Mode:Agg])
    * @return Number of signals parsed
    */
   size_t loadDebugSignals(const String &definitions);
 
+  /**
+   * @brief Load debug watch list (binary WBP or text)
+   * Binary lists start with WBP_MAGIC_WATCH and reuse the WBPSignal layout.
+   * Watched signals that decode the same bits as a ruleset signal (or an
+   * earlier watch entry) share its decode instead of decoding again.
+   * @param data Watch list payload
+   * @param len Payload length
+   * @return Number of signals loaded (0 on parse error)
+   */
+  size_t loadDebugSignals(const uint8_t *data, size_t len);
+
   /// @brief Clear debug signals
   void clearDebugSignals();
 
   /**
-   * @brief Get changed debug signal
-   * @param outSignal Output signal
-   * @return true if dirty signal found
+   * @brief Fill a telemetry frame with due debug signals
+   * A signal is due when its SamplePolicy allows it (interval elapsed and
+   * moved past deadband, or periodic). Scans round-robin from where the
+   * previous frame stopped, so every due signal gets a turn before any
+   * signal is sent twice.
+   * @param out Frame buffer
+   * @param maxLen Buffer capacity (transport MTU)
+   * @param seq Frame sequence number
+   * @return Frame length, 0 if nothing changed
+   */
+  size_t buildDebugFrame(uint8_t *out, size_t maxLen, uint8_t seq);
+
+  /**
+   * @brief Reset telemetry baselines to 0 and resend every known value
+   * The next frame carries WBP_DEBUG_FLAG_KEY.
    */
-  bool popDirtyDebugSignal(RuntimeSignal &outSignal);
+  void resyncDebugSignals();
 
   /// @brief Check debug mode active
   bool isDebugMode() const { return debugMode_; }
@@ -107,31 +148,116 @@ public:
   size_t getRuleCount() const { return rules_.size(); }
   uint32_t getRulesTriggered() const { return rulesTriggered_; }
 
+  /// @brief Bumped whenever capabilities or the ruleset change
+  uint32_t getGeneration() const { return generation_; }
+
 private:
-  std::vector<RuntimeSignal> signals_;
-  std::vector<RuntimeCondition> conditions_;
-  std::vector<RuntimeAction> actions_;
-  std::vector<RuntimeRule> rules_;
-  std::vector<uint8_t> rulesetBinary_;
+  SignalList signals_;
+  SignalState signalState_; // Hot values, parallel to signals_
+  ConditionList conditions_; // Grouped, see compileConditions()
+
+  // Kernel groups, in storage order: float operators (group = Operation,
+  // EQ..OUTSIDE), raw-domain range tests, then HOLD (stateful).
+  static constexpr size_t GROUP_RAW_WITHIN =
+      static_cast<size_t>(Operation::HOLD);
+  static constexpr size_t GROUP_RAW_OUTSIDE = GROUP_RAW_WITHIN + 1;
+  static constexpr size_t GROUP_HOLD = GROUP_RAW_OUTSIDE + 1;
+  static constexpr size_t GROUP_COUNT = GROUP_HOLD + 1;
+
+  // Condition operands as flat arrays for ConditionKernel, in the order of
+  // conditions_. Group g covers [conditionGroups_[g], [g + 1]).
+  uint8_t conditionGroups_[GROUP_COUNT + 1] = {};
+  CapacityVector<uint8_t, W4RP_MAX_CONDITIONS> conditionSignal_;
+  CapacityVector<float, W4RP_MAX_CONDITIONS> conditionValue1_;
+  CapacityVector<float, W4RP_MAX_CONDITIONS> conditionValue2_;
+  CapacityVector<int64_t, W4RP_MAX_CONDITIONS> conditionRawLo_;
+  CapacityVector<int64_t, W4RP_MAX_CONDITIONS> conditionRawHi_;
+  CapacityVector<float, W4RP_MAX_CONDITIONS> conditionInput_;      // Gathered
+  CapacityVector<int64_t, W4RP_MAX_CONDITIONS> conditionRawInput_; // Gathered
+
+  ActionList actions_;
+  ParamTable params_;
+  RuleList rules_;
+  StringPool strings_; // Capability IDs and string params
+  RulesetBinary rulesetBinary_;
   uint32_t rulesetCRC_ = 0;
 
-  std::map<uint32_t, std::vector<RuntimeSignal *>> signalMap_;
-  std::map<String, CapabilityHandler> handlers_;
-  std::map<String, CapabilityMeta> capabilityMeta_;
+  // loadRuleset() parses here and moves in only on success. Members, not
+  // locals: in static-capacity builds these are the full fixed arrays.
+  SignalList pendingSignals_;
+  ConditionList pendingConditions_;
+  ActionList pendingActions_;
+  ParamTable pendingParams_;
+  RuleList pendingRules_;
+  StringPool pendingStrings_;
+
+  /// CAN ID → signal, sorted by canId (binary search, no map nodes)
+  struct SignalRef {
+    uint32_t canId;
+    uint16_t idx;
+  };
+  CapacityVector<SignalRef, W4RP_MAX_SIGNALS> signalIndex_;
+
+  // W4RP_LAZY_DECODE: latest payload per ruleset CAN ID (sorted by canId),
+  // each signal's slot, and the slot version it was last decoded from
+  CapacityVector<FrameSlot, W4RP_MAX_SIGNALS> frameSlots_;
+  CapacityVector<uint16_t, W4RP_MAX_SIGNALS> signalSlot_;
+  CapacityVector<uint32_t, W4RP_MAX_SIGNALS> decodedVersion_;
+
+  /// CapabilityMeta registration: owns the strings its def points into
+  struct OwnedCapability {
+    CapabilityMeta meta;
+    std::vector<CapabilityParamDef> params;
+    CapabilityDef def;
+    OwnedCapability(const String &id, const CapabilityMeta &m);
+  };
+
+  struct Capability {
+    const CapabilityDef *def;
+    ActionInvoker invoke;
+    bool listed; ///< Included in the profile
+    std::unique_ptr<OwnedCapability> owned;
+  };
+
+  // Indexed by capabilityIdx
+  CapacityVector<Capability, W4RP_MAX_CAPABILITIES> capabilities_;
+  CapabilityList profileCapabilities_;
 
   bool debugMode_ = false;
-  std::vector<RuntimeSignal> debugSignals_;
-  std::map<uint32_t, std::vector<size_t>> debugSignalMap_;
-  std::vector<bool> debugDirtyFlags_;
-  std::vector<size_t> debugDirtyQueue_;
-  size_t debugQueueHead_ = 0;
+  DebugSignalList debugSignals_;
+  DebugSignalList pendingDebugSignals_;
+  CapacityVector<SignalRef, W4RP_MAX_DEBUG_SIGNALS> debugIndex_; // Primaries
+  // Per ruleset signal: first watch entry sharing its decode. Followers
+  // of a ruleset signal or primary are chained via DebugSignal::nextLinked.
+  CapacityVector<int16_t, W4RP_MAX_SIGNALS> rulesetDebugHead_;
+  size_t debugCursor_ = 0;
+  bool debugKeyPending_ = false;
 
   uint32_t rulesTriggered_ = 0;
-  String unknownCapability_;
+  uint32_t generation_ = 0;
+  int32_t unknownCapability_ = -1; // ID in pendingStrings_, -1 = none
 
-  bool evaluateCondition(RuntimeCondition &cond, uint32_t nowMs);
+  bool addCapability(Capability &&cap);
+  int findCapability(const char *id) const;
+  uint32_t evaluateConditions(uint32_t nowMs);
+  bool evaluateHold(RuntimeCondition &cond, bool active, uint32_t nowMs);
+  static size_t conditionGroup(const RuntimeCondition &cond);
+  void compileConditions();
   void executeAction(RuntimeAction &action);
   float decodeSignal(const RuntimeSignal &sig, const uint8_t *data);
+  int64_t decodeRaw(const RuntimeSignal &sig, const uint8_t *data);
+  int64_t sampleValue(const DebugSignal &dbg) const;
+  void updateDebugSample(DebugSignal &dbg, int64_t raw);
+  const FrameSlot *storeFrame(const CanFrame &frame, uint32_t nowMs);
+  void refreshSignals();
+  size_t installDebugSignals();
+  void indexSignals();
+  void linkDebugSignals();
+  bool isDebugDue(const DebugSignal &dbg, int64_t value, uint32_t nowMs) const;
+  float scaleRaw(const RuntimeSignal &sig, int64_t raw) const {
+    float val = sig.isSigned ? (float)raw : (float)(uint64_t)raw;
+    return val * sig.factor + sig.offset;
+  }
 };
 
 } // namespace W4RP
@@ -0,0 +1,156 @@
+/**
+ * @file FixedVector.h
+ * @brief CORE:FixedVector - Inline-storage vector for static-capacity builds
+ * @version 1.0.0
+ *
+ * Vector with the capacity fixed at compile time and the elements stored
+ * inline, so it never allocates. It covers the std::vector subset the
+ * engine and controller use, so the same code builds in both modes.
+ *
+ * W4RP_STATIC_CAPACITY 1 switches CapacityVector<T, N> from std::vector
+ * to FixedVector. The N values are the W4RP_MAX_* limits. Loads that
+ * exceed a limit fail (see fitsCapacity()) instead of allocating.
+ */
+#pragma once
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace W4RP {
+
+#ifndef W4RP_STATIC_CAPACITY
+#define W4RP_STATIC_CAPACITY 0 ///< 1 = fixed arrays, no heap after begin()
+#endif
+
+/**
+ * @class FixedVector
+ * @brief std::vector subset over inline storage
+ * @tparam T Element type
+ * @tparam N Capacity; push_back beyond it is ignored (check fitsCapacity)
+ */
+template <typename T, size_t N> class FixedVector {
+  static_assert(N > 0, "FixedVector capacity must be positive");
+
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  FixedVector() = default;
+  FixedVector(const FixedVector &other) { assign(other.begin(), other.end()); }
+  FixedVector(FixedVector &&other) {
+    for (T &item : other)
+      push_back(std::move(item));
+    other.clear();
+  }
+  ~FixedVector() { clear(); }
+
+  FixedVector &operator=(const FixedVector &other) {
+    if (this != &other)
+      assign(other.begin(), other.end());
+    return *this;
+  }
+
+  FixedVector &operator=(FixedVector &&other) {
+    if (this != &other) {
+      clear();
+      for (T &item : other)
+        push_back(std::move(item));
+      other.clear();
+    }
+    return *this;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == N; }
+  static constexpr size_t capacity() { return N; }
+
+  T *data() { return reinterpret_cast<T *>(storage_); }
+  const T *data() const { return reinterpret_cast<const T *>(storage_); }
+  T &operator[](size_t i) { return data()[i]; }
+  const T &operator[](size_t i) const { return data()[i]; }
+  T &back() { return data()[size_ - 1]; }
+  const T &back() const { return data()[size_ - 1]; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+
+  void push_back(const T &item) {
+    if (size_ < N)
+      new (data() + size_++) T(item);
+  }
+
+  void push_back(T &&item) {
+    if (size_ < N)
+      new (data() + size_++) T(std::move(item));
+  }
+
+  void pop_back() {
+    if (size_ > 0)
+      data()[--size_].~T();
+  }
+
+  void clear() {
+    while (size_ > 0)
+      data()[--size_].~T();
+  }
+
+  /// Grow with value-initialized elements or shrink (clamped to N)
+  void resize(size_t n) {
+    if (n > N)
+      n = N;
+    while (size_ > n)
+      pop_back();
+    while (size_ < n)
+      new (data() + size_++) T();
+  }
+
+  void assign(size_t n, const T &value) {
+    clear();
+    for (size_t i = 0; i < n && i < N; i++)
+      push_back(value);
+  }
+
+  template <typename It> void assign(It first, It last) {
+    clear();
+    insert(end(), first, last);
+  }
+
+  /// Append only (pos must be end()), the only form the library uses
+  template <typename It> iterator insert(iterator pos, It first, It last) {
+    for (; first != last && size_ < N; ++first)
+      push_back(*first);
+    return pos;
+  }
+
+  // Storage is fixed: kept for std::vector compatibility
+  void reserve(size_t) {}
+  void shrink_to_fit() {}
+
+private:
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_[N];
+  size_t size_ = 0;
+};
+
+/// std::vector normally, FixedVector<T, N> with W4RP_STATIC_CAPACITY
+template <typename T, size_t N>
+using CapacityVector =
+    typename std::conditional<W4RP_STATIC_CAPACITY != 0, FixedVector<T, N>,
+                              std::vector<T>>::type;
+
+/// Check n elements fit before loading them (always true for std::vector)
+template <typename T, size_t N>
+inline bool fitsCapacity(const FixedVector<T, N> &, size_t n) {
+  return n <= N;
+}
+template <typename T, typename A>
+inline bool fitsCapacity(const std::vector<T, A> &, size_t) {
+  return true;
+}
+
+} // namespace W4RP
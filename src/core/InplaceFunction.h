@@ -0,0 +1,124 @@
+/**
+ * @file InplaceFunction.h
+ * @brief CORE:InplaceFunction - Non-allocating callable wrapper
+ * @version 1.0.0
+ *
+ * Drop-in for std::function in library callbacks. The callable is stored
+ * inline in a fixed buffer, so assigning a capturing lambda never touches
+ * the heap; a capture that does not fit fails to compile instead of
+ * silently allocating. Calls are one indirect jump, with no
+ * small-buffer / heap branch.
+ *
+ * Capacity is in bytes. W4RP_CALLBACK_CAPACITY (default 16) covers
+ * [this], a few pointers or a function pointer + context; raise it
+ * globally, or use a wider InplaceFunction<Sig, N> for a specific slot.
+ */
+#pragma once
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+namespace W4RP {
+
+#ifndef W4RP_CALLBACK_CAPACITY
+#define W4RP_CALLBACK_CAPACITY 16 ///< Inline capture bytes per callback
+#endif
+
+template <typename Signature, size_t Capacity = W4RP_CALLBACK_CAPACITY>
+class InplaceFunction;
+
+/**
+ * @class InplaceFunction
+ * @brief Fixed-capacity, copyable callable
+ * @tparam R Return type
+ * @tparam Args Argument types
+ * @tparam Capacity Inline storage in bytes
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+  InplaceFunction() = default;
+  InplaceFunction(std::nullptr_t) {}
+
+  template <typename F, typename Fn = typename std::decay<F>::type,
+            typename = typename std::enable_if<
+                !std::is_same<Fn, InplaceFunction>::value>::type>
+  InplaceFunction(F &&fn) {
+    static_assert(sizeof(Fn) <= Capacity,
+                  "Callback capture too large: raise W4RP_CALLBACK_CAPACITY "
+                  "or capture less (e.g. a pointer to a context struct)");
+    static_assert(alignof(Fn) <= alignof(Storage),
+                  "Callback capture over-aligned");
+    static_assert(std::is_copy_constructible<Fn>::value,
+                  "Callback must be copyable");
+
+    new (&storage_) Fn(std::forward<F>(fn));
+    invoke_ = &invokeImpl<Fn>;
+    manage_ = &manageImpl<Fn>;
+  }
+
+  InplaceFunction(const InplaceFunction &other) { copyFrom(other); }
+
+  InplaceFunction &operator=(const InplaceFunction &other) {
+    if (this != &other) {
+      reset();
+      copyFrom(other);
+    }
+    return *this;
+  }
+
+  InplaceFunction &operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  ~InplaceFunction() { reset(); }
+
+  explicit operator bool() const { return invoke_ != nullptr; }
+
+  R operator()(Args... args) const {
+    return invoke_(&storage_, std::forward<Args>(args)...);
+  }
+
+private:
+  using Storage =
+      typename std::aligned_storage<Capacity, alignof(void *)>::type;
+  using InvokeFn = R (*)(const void *, Args &&...);
+  using ManageFn = void (*)(void *dst, const void *src); // src null: destroy
+
+  // mutable: calling a const InplaceFunction may still mutate the
+  // captured state, as with std::function
+  mutable Storage storage_;
+  InvokeFn invoke_ = nullptr;
+  ManageFn manage_ = nullptr;
+
+  template <typename Fn>
+  static R invokeImpl(const void *storage, Args &&...args) {
+    return (*static_cast<Fn *>(const_cast<void *>(storage)))(
+        std::forward<Args>(args)...);
+  }
+
+  template <typename Fn> static void manageImpl(void *dst, const void *src) {
+    if (src)
+      new (dst) Fn(*static_cast<const Fn *>(src));
+    else
+      static_cast<Fn *>(dst)->~Fn();
+  }
+
+  void copyFrom(const InplaceFunction &other) {
+    if (other.manage_)
+      other.manage_(&storage_, &other.storage_);
+    invoke_ = other.invoke_;
+    manage_ = other.manage_;
+  }
+
+  void reset() {
+    if (manage_)
+      manage_(&storage_, nullptr);
+    invoke_ = nullptr;
+    manage_ = nullptr;
+  }
+};
+
+} // namespace W4RP
@@ -0,0 +1,130 @@
+/**
+ * @file PacketRing.h
+ * @brief CORE:PacketRing - Lock-free SPSC packet inbox
+ * @version 1.0.0
+ *
+ * Fixed-size single-producer / single-consumer ring of packet slots.
+ * The transport callback (BLE task) pushes, Controller::loop() pops.
+ * No locks, no heap: slots are preallocated and the consumer reads
+ * packets in place (front() / pop()), so stream chunks are copied once.
+ *
+ * After a drop, the next packet that fits is flagged W4RP_PACKET_AFTER_GAP,
+ * so the consumer sees exactly where packets went missing.
+ */
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace W4RP {
+
+/// Slot flags
+#define W4RP_PACKET_DATA 0x00
+#define W4RP_PACKET_CONTINUED 0x01 ///< More of the same packet follows
+#define W4RP_PACKET_DISCONNECT 0x02 ///< Link dropped (no payload)
+#define W4RP_PACKET_AFTER_GAP 0x04 ///< Packets were dropped just before
+
+/**
+ * @class PacketRing
+ * @brief SPSC ring of fixed-size packet slots
+ * @tparam Slots Slot count (power of two)
+ * @tparam SlotSize Max bytes per slot; longer packets span several slots
+ */
+template <size_t Slots, size_t SlotSize> class PacketRing {
+  static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+  static_assert(SlotSize > 0 && SlotSize <= 0xFFFF, "Invalid slot size");
+
+public:
+  struct Packet {
+    const uint8_t *data;
+    size_t len;
+    uint8_t flags;
+  };
+
+  /**
+   * @brief Producer: copy packet into free slot(s)
+   * All-or-nothing: a packet is dropped whole if it does not fit.
+   * @param data Packet data
+   * @param len Packet length
+   * @param flags W4RP_PACKET_* for single-slot events
+   * @return false if the ring is full (packet dropped and counted, next
+   *         packet flagged W4RP_PACKET_AFTER_GAP)
+   */
+  bool push(const uint8_t *data, size_t len,
+            uint8_t flags = W4RP_PACKET_DATA) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+
+    size_t needed = (len == 0) ? 1 : (len + SlotSize - 1) / SlotSize;
+    if (Slots - (head - tail) < needed) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      gap_ = true;
+      return false;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < needed; i++) {
+      Slot &slot = slots_[(head + i) & (Slots - 1)];
+      size_t chunk = (len - offset > SlotSize) ? SlotSize : (len - offset);
+      if (chunk > 0)
+        memcpy(slot.data, data + offset, chunk);
+      slot.len = (uint16_t)chunk;
+      slot.flags = (i + 1 < needed) ? W4RP_PACKET_CONTINUED : flags;
+      if (i == 0 && gap_)
+        slot.flags |= W4RP_PACKET_AFTER_GAP; // First slot only
+      offset += chunk;
+    }
+    gap_ = false;
+
+    head_.store(head + needed, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Consumer: peek oldest slot without copying
+   * @param out Slot view, valid until pop()
+   * @return false if empty
+   */
+  bool front(Packet &out) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return false;
+
+    const Slot &slot = slots_[tail & (Slots - 1)];
+    out.data = slot.data;
+    out.len = slot.len;
+    out.flags = slot.flags;
+    return true;
+  }
+
+  /// @brief Consumer: release the slot returned by front()
+  void pop() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  /// @brief Packets dropped because the ring was full
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  /// @brief Slots currently in use (approximate from either side)
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Slot {
+    uint16_t len;
+    uint8_t flags;
+    uint8_t data[SlotSize];
+  };
+
+  Slot slots_[Slots];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+  bool gap_ = false; ///< Producer only: a drop since the last push
+};
+
+} // namespace W4RP
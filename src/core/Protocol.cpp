@@ -13,27 +13,42 @@ uint32_t Protocol::calculateCRC32(const uint8_t *data, size_t len) {
   return esp_crc32_le(0, data, len);
 }
 
-static String readStringFromTable(const uint8_t *stringTable, uint16_t offset,
-                                  size_t tableLen) {
-  if (offset >= tableLen)
-    return String();
-
-  const char *ptr = reinterpret_cast<const char *>(stringTable + offset);
-  size_t maxLen = tableLen - offset;
-  size_t len = strnlen(ptr, maxLen);
-
-  if (len == maxLen && (offset + len >= tableLen || ptr[len] != '\0')) {
-    return String();
+// Intern a string table entry; a bad offset or unterminated entry reads
+// as "". Returns false only when the pool is full.
+static bool internString(const uint8_t *stringTable, uint16_t offset,
+                         size_t tableLen, StringPool &pool, uint16_t &id) {
+  const char *str = "";
+  size_t len = 0;
+
+  if (offset < tableLen) {
+    const char *ptr = reinterpret_cast<const char *>(stringTable + offset);
+    size_t maxLen = tableLen - offset;
+    size_t n = strnlen(ptr, maxLen);
+    if (n < maxLen) {
+      str = ptr;
+      len = n;
+    }
   }
 
-  return String(ptr, len);
+  return pool.intern(str, len, id);
+}
+
+static RuntimeSignal toRuntimeSignal(const WBPSignal &src) {
+  RuntimeSignal sig = {};
+  sig.canId = src.canId;
+  sig.startBit = src.startBit;
+  sig.bitLength = src.bitLength;
+  sig.bigEndian = (src.flags & 0x01) != 0;
+  sig.isSigned = (src.flags & 0x02) != 0;
+  sig.factor = src.factor;
+  sig.offset = src.offset;
+  return sig;
 }
 
 bool Protocol::parseRules(const uint8_t *data, size_t len,
-                          std::vector<RuntimeSignal> &outSignals,
-                          std::vector<RuntimeCondition> &outConditions,
-                          std::vector<RuntimeAction> &outActions,
-                          std::vector<RuntimeRule> &outRules) {
+                          SignalList &outSignals, ConditionList &outConditions,
+                          ActionList &outActions, ParamTable &outParams,
+                          RuleList &outRules, StringPool &outStrings) {
   // Validate minimum length
   if (len < sizeof(WBPRulesHeader)) {
     Serial.println("[WBP] Error: Data too short for header");
@@ -106,24 +121,28 @@ bool Protocol::parseRules(const uint8_t *data, size_t len,
     return false;
   }
 
+  // Static-capacity builds: a ruleset larger than W4RP_MAX_* is rejected
+  if (!fitsCapacity(outSignals, header->signalCount) ||
+      !fitsCapacity(outConditions, header->conditionCount) ||
+      !fitsCapacity(outActions, header->actionCount) ||
+      !fitsCapacity(outParams, header->actionParamCount) ||
+      !fitsCapacity(outRules, header->ruleCount)) {
+    Serial.println("[WBP] Error: Ruleset exceeds capacity");
+    return false;
+  }
+
   const uint8_t *stringTable = data + header->stringTableOffset;
   size_t stringTableLen = header->totalSize - header->stringTableOffset;
 
+  outStrings.clear();
+
   // Parse Signals
   outSignals.clear();
   outSignals.reserve(header->signalCount);
   const WBPSignal *signals = reinterpret_cast<const WBPSignal *>(data + offset);
 
   for (int i = 0; i < header->signalCount; i++) {
-    RuntimeSignal sig = {};
-    sig.canId = signals[i].canId;
-    sig.startBit = signals[i].startBit;
-    sig.bitLength = signals[i].bitLength;
-    sig.bigEndian = (signals[i].flags & 0x01) != 0;
-    sig.isSigned = (signals[i].flags & 0x02) != 0;
-    sig.factor = signals[i].factor;
-    sig.offset = signals[i].offset;
-    outSignals.push_back(sig);
+    outSignals.push_back(toRuntimeSignal(signals[i]));
   }
   offset += header->signalCount * sizeof(WBPSignal);
 
@@ -178,56 +197,65 @@ bool Protocol::parseRules(const uint8_t *data, size_t len,
       reinterpret_cast<const WBPActionParam *>(data + offset);
   offset += header->actionParamCount * sizeof(WBPActionParam);
 
+  // Parameter table: converted once, actions index into it as in WBP
+  outParams.clear();
+  outParams.reserve(header->actionParamCount);
+  for (int j = 0; j < header->actionParamCount; j++) {
+    const WBPActionParam &ap = actionParams[j];
+    RuntimeParam param = {};
+
+    // Validate param type
+    if (ap.type > static_cast<uint8_t>(ParamType::BOOL)) {
+      Serial.printf("[WBP] Error: Param %d has invalid type %d\n", j, ap.type);
+      return false;
+    }
+    param.type = static_cast<ParamType>(ap.type);
+
+    switch (param.type) {
+    case ParamType::INT:
+    case ParamType::BOOL:
+      param.intVal = static_cast<int32_t>(ap.value);
+      break;
+    case ParamType::FLOAT:
+      param.floatVal = static_cast<float>(ap.value) / 100.0f;
+      break;
+    case ParamType::STRING:
+      if (!internString(stringTable, ap.value, stringTableLen, outStrings,
+                        param.strId)) {
+        Serial.println("[WBP] Error: String pool full");
+        return false;
+      }
+      break;
+    }
+
+    outParams.push_back(param);
+  }
+
   for (int i = 0; i < header->actionCount; i++) {
     RuntimeAction action = {};
-    action.capabilityId =
-        readStringFromTable(stringTable, actions[i].capStrIdx, stringTableLen);
+    if (!internString(stringTable, actions[i].capStrIdx, stringTableLen,
+                      outStrings, action.capabilityStrId)) {
+      Serial.println("[WBP] Error: String pool full");
+      return false;
+    }
 
-    if (action.capabilityId.isEmpty()) {
+    if (action.capabilityStrId == StringPool::EMPTY) {
       Serial.printf("[WBP] Error: Empty capability ID at action %d\n", i);
       return false;
     }
 
     // Bounds check for param start index
-    uint8_t paramStart = actions[i].paramStartIdx;
-    uint8_t paramCount = actions[i].paramCount;
+    action.paramStart = actions[i].paramStartIdx;
+    action.paramCount = actions[i].paramCount;
 
-    if (paramStart + paramCount > header->actionParamCount) {
+    if (action.paramStart + action.paramCount > header->actionParamCount) {
       Serial.printf("[WBP] Error: Action %d param overflow (start=%d count=%d "
                     "total=%d)\n",
-                    i, paramStart, paramCount, header->actionParamCount);
+                    i, action.paramStart, action.paramCount,
+                    header->actionParamCount);
       return false;
     }
 
-    for (int j = 0; j < paramCount; j++) {
-      const WBPActionParam &ap = actionParams[paramStart + j];
-      RuntimeParam param = {};
-
-      // Validate param type
-      if (ap.type > static_cast<uint8_t>(ParamType::BOOL)) {
-        Serial.printf("[WBP] Error: Action %d param %d has invalid type %d\n",
-                      i, j, ap.type);
-        return false;
-      }
-      param.type = static_cast<ParamType>(ap.type);
-
-      switch (param.type) {
-      case ParamType::INT:
-      case ParamType::BOOL:
-        param.intVal = static_cast<int32_t>(ap.value);
-        break;
-      case ParamType::FLOAT:
-        param.floatVal = static_cast<float>(ap.value) / 100.0f;
-        break;
-      case ParamType::STRING:
-        param.strVal =
-            readStringFromTable(stringTable, ap.value, stringTableLen);
-        break;
-      }
-
-      action.params.push_back(param);
-    }
-
     outActions.push_back(action);
   }
 
@@ -274,112 +302,152 @@ bool Protocol::parseRules(const uint8_t *data, size_t len,
   return true;
 }
 
-class StringTableBuilder {
-public:
-  uint16_t add(const String &str) {
-    auto it = indexMap_.find(str);
-    if (it != indexMap_.end())
-      return it->second;
+bool Protocol::isWatchList(const uint8_t *data, size_t len) {
+  if (len < sizeof(WBPWatchHeader))
+    return false;
 
-    if (currentOffset_ + str.length() + 1 > 0xFFF0) {
-      Serial.println("[WBP] String table overflow");
-      return 0;
-    }
+  uint32_t magic;
+  memcpy(&magic, data, sizeof(magic));
+  return magic == WBP_MAGIC_WATCH;
+}
 
-    uint16_t offset = currentOffset_;
-    strings_.push_back(str);
-    indexMap_[str] = offset;
-    currentOffset_ += str.length() + 1;
-    return offset;
+bool Protocol::parseWatchList(const uint8_t *data, size_t len,
+                              DebugSignalList &outSignals) {
+  if (!isWatchList(data, len)) {
+    Serial.println("[WBP] Error: Not a watch list");
+    return false;
   }
 
-  size_t size() const { return currentOffset_; }
+  WBPWatchHeader header;
+  memcpy(&header, data, sizeof(header));
 
-  void write(uint8_t *dest) const {
-    size_t pos = 0;
-    for (const String &s : strings_) {
-      memcpy(dest + pos, s.c_str(), s.length());
-      pos += s.length();
-      dest[pos++] = 0;
-    }
+  if (header.version < WBP_MIN_VERSION || header.version > WBP_VERSION) {
+    Serial.printf("[WBP] Error: Unsupported version %d\n", header.version);
+    return false;
   }
 
-private:
-  std::vector<String> strings_;
-  std::map<String, uint16_t> indexMap_;
-  uint16_t currentOffset_ = 0;
-};
+  bool hasPolicy = (header.flags & WBP_WATCH_FLAG_POLICY) != 0;
+  size_t expectedSize =
+      sizeof(WBPWatchHeader) + header.signalCount * sizeof(WBPSignal) +
+      (hasPolicy ? header.signalCount * sizeof(WBPWatchPolicy) : 0);
 
-size_t Protocol::serializeProfile(
-    uint8_t *outBuffer, size_t maxLen, const char *moduleId,
-    const char *hwVersion, const char *fwVersion, const char *serial,
-    uint32_t uptimeMs, uint16_t bootCount, uint8_t rulesMode, uint32_t rulesCRC,
-    uint8_t signalCount, uint8_t conditionCount, uint8_t actionCount,
-    uint8_t ruleCount,
-    const std::vector<std::pair<String, CapabilityMeta>> &capabilities) {
-  StringTableBuilder strTable;
+  if (expectedSize > len) {
+    Serial.println("[WBP] Error: Counts exceed buffer");
+    return false;
+  }
 
-  uint16_t moduleIdIdx = strTable.add(String(moduleId));
-  uint16_t hwIdx = strTable.add(String(hwVersion));
-  uint16_t fwIdx = strTable.add(String(fwVersion));
-  uint16_t serialIdx = strTable.add(String(serial ? serial : ""));
+  if (!fitsCapacity(outSignals, header.signalCount)) {
+    Serial.println("[WBP] Error: Watch list exceeds capacity");
+    return false;
+  }
 
-  std::vector<WBPCapability> capEntries;
-  std::vector<WBPCapParam> capParams;
+  const WBPSignal *signals =
+      reinterpret_cast<const WBPSignal *>(data + sizeof(WBPWatchHeader));
+  const WBPWatchPolicy *policies = reinterpret_cast<const WBPWatchPolicy *>(
+      data + sizeof(WBPWatchHeader) + header.signalCount * sizeof(WBPSignal));
 
-  for (const auto &entry : capabilities) {
-    const CapabilityMeta &meta = entry.second;
-    WBPCapability cap = {};
-    cap.idStrIdx = strTable.add(meta.id);
-    cap.labelStrIdx = strTable.add(meta.label);
-    cap.descStrIdx = strTable.add(meta.description);
-    cap.categoryStrIdx = strTable.add(meta.category);
-    cap.paramCount = meta.params.size();
-    cap.paramStartIdx = capParams.size();
-
-    for (const auto &p : meta.params) {
-      WBPCapParam param = {};
-      param.nameStrIdx = strTable.add(p.name);
-      param.descStrIdx = strTable.add(p.description);
-
-      if (p.type == "int")
-        param.type = static_cast<uint8_t>(ParamType::INT);
-      else if (p.type == "float")
-        param.type = static_cast<uint8_t>(ParamType::FLOAT);
-      else if (p.type == "string")
-        param.type = static_cast<uint8_t>(ParamType::STRING);
-      else if (p.type == "bool")
-        param.type = static_cast<uint8_t>(ParamType::BOOL);
-      else
-        param.type = static_cast<uint8_t>(ParamType::INT);
+  outSignals.clear();
+  outSignals.reserve(header.signalCount);
 
-      param.required = p.required ? 1 : 0;
-      param.min = p.min;
-      param.max = p.max;
-      capParams.push_back(param);
+  for (int i = 0; i < header.signalCount; i++) {
+    DebugSignal dbg = {};
+    dbg.sig = toRuntimeSignal(signals[i]);
+
+    if (dbg.sig.bitLength == 0 || dbg.sig.bitLength > 64) {
+      Serial.printf("[WBP] Error: Watch %d has invalid length %d\n", i,
+                    dbg.sig.bitLength);
+      return false;
     }
 
-    capEntries.push_back(cap);
+    if (hasPolicy) {
+      const WBPWatchPolicy &p = policies[i];
+      if (p.mode > static_cast<uint8_t>(SampleMode::PERIODIC) ||
+          p.aggregate > static_cast<uint8_t>(SampleAggregate::AVG)) {
+        Serial.printf("[WBP] Error: Watch %d has invalid policy\n", i);
+        return false;
+      }
+      dbg.policy.minIntervalMs = p.minIntervalMs;
+      dbg.policy.mode = static_cast<SampleMode>(p.mode);
+      dbg.policy.aggregate = static_cast<SampleAggregate>(p.aggregate);
+      dbg.policy.deadband = p.deadband;
+    }
+
+    outSignals.push_back(dbg);
+  }
+
+  return true;
+}
+
+static size_t textLength(const char *str) { return str ? strlen(str) : 0; }
+
+// String table layout: index 0 is the shared empty string, every other
+// string gets the next offset in emission order (no lookup table)
+class StringCursor {
+public:
+  uint16_t add(size_t len) {
+    if (len == 0)
+      return 0;
+    uint16_t offset = (uint16_t)next_;
+    next_ += len + 1;
+    return offset;
   }
 
-  size_t headerSize = sizeof(WBPProfileHeader);
-  size_t capsSize = capEntries.size() * sizeof(WBPCapability);
-  size_t paramsSize = capParams.size() * sizeof(WBPCapParam);
-  size_t stringSize = strTable.size();
-  size_t totalSize = headerSize + capsSize + paramsSize + stringSize;
+  size_t size() const { return next_; }
 
-  if (totalSize > maxLen)
+private:
+  size_t next_ = 1;
+};
+
+size_t Protocol::serializeProfile(
+    const ByteSink &sink, const char *moduleId, const char *hwVersion,
+    const char *fwVersion, const char *serial, uint32_t uptimeMs,
+    uint16_t bootCount, uint8_t rulesMode, uint32_t rulesCRC,
+    uint8_t signalCount, uint8_t conditionCount, uint8_t actionCount,
+    uint8_t ruleCount,
+    const CapabilityList &capabilities) {
+  if (!serial)
+    serial = "";
+  const char *moduleStrings[] = {moduleId, hwVersion, fwVersion, serial};
+
+  // Size pass: counts and string bytes, checked against field widths
+  size_t paramCount = 0;
+  StringCursor sizing;
+  for (const char *str : moduleStrings)
+    sizing.add(strlen(str));
+  for (const CapabilityDef *def : capabilities) {
+    sizing.add(textLength(def->id));
+    sizing.add(textLength(def->label));
+    sizing.add(textLength(def->description));
+    sizing.add(textLength(def->category));
+    for (size_t i = 0; i < def->paramCount; i++) {
+      sizing.add(textLength(def->params[i].name));
+      sizing.add(textLength(def->params[i].description));
+    }
+    paramCount += def->paramCount;
+  }
+
+  size_t stringTableOffset = sizeof(WBPProfileHeader) +
+                             capabilities.size() * sizeof(WBPCapability) +
+                             paramCount * sizeof(WBPCapParam);
+  // 8-bit counts / paramStartIdx, 16-bit offsets
+  if (capabilities.size() > 0xFF || paramCount > 0xFF ||
+      stringTableOffset > 0xFFFF || sizing.size() > 0x10000) {
+    Serial.println("[WBP] Profile exceeds format limits");
     return 0;
+  }
+
+  // Emit pass: the cursor hands out the same offsets as the size pass
+  StringCursor strings;
 
   WBPProfileHeader header = {};
   header.magic = WBP_MAGIC_PROFILE;
   header.version = WBP_VERSION;
   header.flags = (rulesCRC != 0) ? 0x01 : 0x00;
-  header.moduleIdStrIdx = moduleIdIdx;
-  header.hwStrIdx = hwIdx;
-  header.fwStrIdx = fwIdx;
-  header.serialStrIdx = serialIdx;
-  header.capabilityCount = capEntries.size();
+  header.moduleIdStrIdx = strings.add(strlen(moduleId));
+  header.hwStrIdx = strings.add(strlen(hwVersion));
+  header.fwStrIdx = strings.add(strlen(fwVersion));
+  header.serialStrIdx = strings.add(strlen(serial));
+  header.capabilityCount = capabilities.size();
   header.rulesMode = rulesMode;
   header.rulesCRC = rulesCRC;
   header.signalCount = signalCount;
@@ -388,25 +456,272 @@ size_t Protocol::serializeProfile(
   header.ruleCount = ruleCount;
   header.uptimeMs = uptimeMs;
   header.bootCount = bootCount;
-  header.stringTableOffset = headerSize + capsSize + paramsSize;
+  header.stringTableOffset = stringTableOffset;
+  sink((const uint8_t *)&header, sizeof(header));
+
+  // Capabilities first; their params follow as one block, so param
+  // strings come after all capability strings
+  uint8_t paramStart = 0;
+  for (const CapabilityDef *def : capabilities) {
+    WBPCapability cap = {};
+    cap.idStrIdx = strings.add(textLength(def->id));
+    cap.labelStrIdx = strings.add(textLength(def->label));
+    cap.descStrIdx = strings.add(textLength(def->description));
+    cap.categoryStrIdx = strings.add(textLength(def->category));
+    cap.paramCount = def->paramCount;
+    cap.paramStartIdx = paramStart;
+    paramStart += def->paramCount;
+    sink((const uint8_t *)&cap, sizeof(cap));
+  }
 
-  size_t offset = 0;
-  memcpy(outBuffer + offset, &header, sizeof(header));
-  offset += sizeof(header);
+  for (const CapabilityDef *def : capabilities) {
+    for (size_t i = 0; i < def->paramCount; i++) {
+      const CapabilityParamDef &p = def->params[i];
+      WBPCapParam param = {};
+      param.nameStrIdx = strings.add(textLength(p.name));
+      param.descStrIdx = strings.add(textLength(p.description));
+      param.type = static_cast<uint8_t>(p.type);
+      param.required = p.required ? 1 : 0;
+      param.min = p.min;
+      param.max = p.max;
+      sink((const uint8_t *)&param, sizeof(param));
+    }
+  }
 
-  for (const auto &cap : capEntries) {
-    memcpy(outBuffer + offset, &cap, sizeof(cap));
-    offset += sizeof(cap);
+  // String table, same order as the indices above
+  static const uint8_t nul = 0;
+  auto emit = [&sink](const char *str) {
+    size_t len = textLength(str);
+    if (len > 0)
+      sink((const uint8_t *)str, len + 1); // Including terminator
+  };
+
+  sink(&nul, 1); // Index 0: empty string
+  for (const char *str : moduleStrings)
+    emit(str);
+  for (const CapabilityDef *def : capabilities) {
+    emit(def->id);
+    emit(def->label);
+    emit(def->description);
+    emit(def->category);
+  }
+  for (const CapabilityDef *def : capabilities) {
+    for (size_t i = 0; i < def->paramCount; i++) {
+      emit(def->params[i].name);
+      emit(def->params[i].description);
+    }
   }
 
-  for (const auto &param : capParams) {
-    memcpy(outBuffer + offset, &param, sizeof(param));
-    offset += sizeof(param);
+  return stringTableOffset + strings.size();
+}
+
+// Argument bytes per opcode, indexed by opcode & 0x7F (0xFF = not a command)
+static const uint8_t kCommandArgSize[WBP_CMD_COUNT] = {
+    0xFF,                  // 0x80 reserved
+    0, 0, 0, 0, 0,         // GET_*, DEBUG_START/STOP/SYNC
+    sizeof(WBPStreamArgs), // DEBUG_WATCH
+    sizeof(WBPStreamArgs), // SET_RULES_RAM
+    sizeof(WBPStreamArgs), // SET_RULES_NVS
+    sizeof(WBPStreamArgs), // OTA_BEGIN
+    sizeof(WBPStreamArgs), // OTA_DELTA
+    0,                     // OTA_CANCEL
+    sizeof(WBPResumeArgs), // RESUME
+    0xFF,                  // STREAM_ACK (response only)
+    sizeof(WBPCompressedArgs) // OTA_BEGIN_Z
+};
+
+CommandStatus Protocol::parseCommand(const uint8_t *data, size_t len,
+                                     Command &out) {
+  out = Command();
+  out.binary = true;
+
+  if (len < sizeof(WBPCommandHeader))
+    return CommandStatus::BAD_ARGS;
+
+  WBPCommandHeader header;
+  memcpy(&header, data, sizeof(header));
+  out.op = (CommandOp)header.opcode;
+  out.requestId = header.requestId;
+
+  uint8_t index = header.opcode & 0x7F;
+  if (index >= WBP_CMD_COUNT || kCommandArgSize[index] == 0xFF)
+    return CommandStatus::UNKNOWN;
+
+  if (len != sizeof(WBPCommandHeader) + kCommandArgSize[index])
+    return CommandStatus::BAD_ARGS;
+
+  const uint8_t *args = data + sizeof(WBPCommandHeader);
+  if (kCommandArgSize[index] == sizeof(WBPStreamArgs)) {
+    WBPStreamArgs stream;
+    memcpy(&stream, args, sizeof(stream));
+    out.length = stream.length;
+    out.crc = stream.crc;
+  } else if (kCommandArgSize[index] == sizeof(WBPCompressedArgs)) {
+    WBPCompressedArgs image;
+    memcpy(&image, args, sizeof(image));
+    out.length = image.length;
+    out.crc = image.crc;
+    out.imageSize = image.imageSize;
+  } else if (kCommandArgSize[index] == sizeof(WBPResumeArgs)) {
+    WBPResumeArgs resume;
+    memcpy(&resume, args, sizeof(resume));
+    out.session = resume.sessionId;
   }
 
-  strTable.write(outBuffer + offset);
+  return CommandStatus::OK;
+}
+
+// Legacy text commands. crcBase 0 = no arguments, else
+// "<prefix><len>:<crc>" with crc in that base
+// ("<prefix><len>:<imageSize>:<crc>" when sized).
+struct TextCommand {
+  const char *text;
+  CommandOp op;
+  uint8_t crcBase;
+  bool sized;
+};
+
+static const TextCommand kTextCommands[] = {
+    {"GET:PROFILE", CommandOp::GET_PROFILE, 0, false},
+    {"GET:RULES", CommandOp::GET_RULES, 0, false},
+    {"DEBUG:START", CommandOp::DEBUG_START, 0, false},
+    {"DEBUG:SYNC", CommandOp::DEBUG_SYNC, 0, false},
+    {"DEBUG:STOP", CommandOp::DEBUG_STOP, 0, false},
+    {"DEBUG:WATCH:", CommandOp::DEBUG_WATCH, 10, false},
+    {"SET:RULES:RAM:", CommandOp::SET_RULES_RAM, 10, false},
+    {"SET:RULES:NVS:", CommandOp::SET_RULES_NVS, 10, false},
+    {"OTA:BEGIN:", CommandOp::OTA_BEGIN, 16, false},
+    {"OTA:DELTA:", CommandOp::OTA_DELTA, 16, false},
+    {"OTA:ZBEGIN:", CommandOp::OTA_BEGIN_Z, 16, true},
+    {"OTA:CANCEL", CommandOp::OTA_CANCEL, 0, false},
+};
+
+static bool parseUint(const char *&p, const char *end, uint8_t base,
+                      uint32_t &out) {
+  const char *start = p;
+  uint32_t value = 0;
+  while (p < end) {
+    char c = *p;
+    uint8_t digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (base == 16 && c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (base == 16 && c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      break;
+    value = value * base + digit;
+    p++;
+  }
+  out = value;
+  return p > start;
+}
 
-  return totalSize;
+bool Protocol::parseTextCommand(const uint8_t *data, size_t len,
+                                Command &out) {
+  const char *p = (const char *)data;
+  const char *end = p + len;
+
+  // Trim whitespace
+  while (p < end && (uint8_t)*p <= ' ')
+    p++;
+  while (end > p && (uint8_t)end[-1] <= ' ')
+    end--;
+
+  size_t textLen = end - p;
+
+  for (const TextCommand &tc : kTextCommands) {
+    size_t n = strlen(tc.text);
+
+    if (tc.crcBase == 0) {
+      if (textLen != n || memcmp(p, tc.text, n) != 0)
+        continue;
+      out = Command();
+      out.op = tc.op;
+      return true;
+    }
+
+    if (textLen <= n || memcmp(p, tc.text, n) != 0)
+      continue;
+
+    const char *q = p + n;
+    Command cmd;
+    cmd.op = tc.op;
+    if (!parseUint(q, end, 10, cmd.length) || q >= end || *q != ':')
+      return false;
+    q++;
+    if (tc.sized) {
+      if (!parseUint(q, end, 10, cmd.imageSize) || q >= end || *q != ':')
+        return false;
+      q++;
+    }
+    if (!parseUint(q, end, tc.crcBase, cmd.crc) || q != end)
+      return false;
+
+    out = cmd;
+    return true;
+  }
+
+  return false;
+}
+
+size_t Protocol::buildResponse(uint8_t *out, size_t maxLen, const Command &cmd,
+                               CommandStatus status, const uint8_t *payload,
+                               size_t payloadLen) {
+  if (maxLen < sizeof(WBPResponse))
+    return 0;
+
+  WBPResponse response;
+  response.marker = WBP_CMD_RESPONSE;
+  response.opcode = (uint8_t)cmd.op;
+  response.requestId = cmd.requestId;
+  response.status = (uint8_t)status;
+  memcpy(out, &response, sizeof(response));
+
+  size_t room = maxLen - sizeof(response);
+  if (payloadLen > room)
+    payloadLen = room;
+  if (payloadLen > 0)
+    memcpy(out + sizeof(response), payload, payloadLen);
+
+  return sizeof(response) + payloadLen;
+}
+
+size_t Protocol::encodeVarint(uint64_t value, uint8_t *out) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+DebugFrameWriter::DebugFrameWriter(uint8_t *buffer, size_t capacity,
+                                   uint8_t seq, uint8_t flags)
+    : buffer_(buffer), capacity_(capacity), len_(HEADER_SIZE) {
+  buffer_[0] = WBP_DEBUG_FRAME;
+  buffer_[1] = flags;
+  buffer_[2] = seq;
+  buffer_[3] = 0;
+}
+
+bool DebugFrameWriter::add(uint16_t index, int64_t delta) {
+  if (buffer_[3] == 0xFF)
+    return false;
+
+  uint8_t tmp[3 + 10];
+  size_t n = Protocol::encodeVarint(index, tmp);
+  n += Protocol::encodeVarint(Protocol::zigzag(delta), tmp + n);
+
+  if (len_ + n > capacity_)
+    return false;
+
+  memcpy(buffer_ + len_, tmp, n);
+  len_ += n;
+  buffer_[3]++;
+  return true;
 }
 
 } // namespace W4RP
@@ -6,11 +6,15 @@
  * WBP (W4RP Binary Protocol) for rules and profile.
  */
 #pragma once
+#include "Capability.h"
 #include "Types.h"
 #include <vector>
 
 namespace W4RP {
 
+/// Receives streamed serializer output
+using ByteSink = InplaceFunction<void(const uint8_t *data, size_t len)>;
+
 /**
  * @class Protocol
  * @brief WBP protocol utilities
@@ -32,26 +36,147 @@ public:
    * @param outSignals Output signals
    * @param outConditions Output conditions
    * @param outActions Output actions
+   * @param outParams Output action parameters (indexed by the actions)
    * @param outRules Output rules
+   * @param outStrings Output string pool (capability IDs, string params)
    * @return true if parsed successfully
    */
   static bool parseRules(const uint8_t *data, size_t len,
-                         std::vector<RuntimeSignal> &outSignals,
-                         std::vector<RuntimeCondition> &outConditions,
-                         std::vector<RuntimeAction> &outActions,
-                         std::vector<RuntimeRule> &outRules);
+                         SignalList &outSignals, ConditionList &outConditions,
+                         ActionList &outActions, ParamTable &outParams,
+                         RuleList &outRules, StringPool &outStrings);
 
   /**
-   * @brief Serialize module profile to WBP
-   * @return Bytes written
+   * @brief Parse binary debug watch list
+   * @param data WBPWatchHeader + WBPSignal[] (+ WBPWatchPolicy[])
+   * @param len Data length
+   * @param outSignals Output watch entries
+   * @return true if parsed successfully
+   */
+  static bool parseWatchList(const uint8_t *data, size_t len,
+                             DebugSignalList &outSignals);
+
+  /**
+   * @brief Check whether a payload is a binary watch list
+   * @param data Payload
+   * @param len Payload length
+   * @return true if it starts with WBP_MAGIC_WATCH
+   */
+  static bool isWatchList(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Serialize module profile to WBP, streamed in order
+   * Size check, then one emit pass with no intermediate buffers: string
+   * indices are assigned in emission order (empty strings share index 0).
+   * Only the format's 8/16-bit counts and offsets limit the size.
+   * @param sink Receives the profile piece by piece
+   * @return Total bytes emitted, 0 if the format limits are exceeded
+   *         (nothing emitted)
    */
   static size_t serializeProfile(
-      uint8_t *outBuffer, size_t maxLen, const char *moduleId,
-      const char *hwVersion, const char *fwVersion, const char *serial,
-      uint32_t uptimeMs, uint16_t bootCount, uint8_t rulesMode,
-      uint32_t rulesCRC, uint8_t signalCount, uint8_t conditionCount,
-      uint8_t actionCount, uint8_t ruleCount,
-      const std::vector<std::pair<String, CapabilityMeta>> &capabilities);
+      const ByteSink &sink, const char *moduleId, const char *hwVersion,
+      const char *fwVersion, const char *serial, uint32_t uptimeMs,
+      uint16_t bootCount, uint8_t rulesMode, uint32_t rulesCRC,
+      uint8_t signalCount, uint8_t conditionCount, uint8_t actionCount,
+      uint8_t ruleCount,
+      const CapabilityList &capabilities);
+
+  /**
+   * @brief Check whether a packet is a binary command
+   * @param data Packet
+   * @param len Packet length
+   * @return true if the first byte has bit 7 set
+   */
+  static bool isBinaryCommand(const uint8_t *data, size_t len) {
+    return len > 0 && (data[0] & 0x80);
+  }
+
+  /**
+   * @brief Decode binary command: WBPCommandHeader (+ args)
+   * @param data Packet
+   * @param len Packet length
+   * @param out Decoded command (op/requestId set even on error)
+   * @return OK, UNKNOWN or BAD_ARGS
+   */
+  static CommandStatus parseCommand(const uint8_t *data, size_t len,
+                                    Command &out);
+
+  /**
+   * @brief Decode legacy text command (e.g. "SET:RULES:RAM:<len>:<crc>")
+   * @param data Packet (not null-terminated)
+   * @param len Packet length
+   * @param out Decoded command
+   * @return false if not a known command
+   */
+  static bool parseTextCommand(const uint8_t *data, size_t len, Command &out);
+
+  /**
+   * @brief Build binary response: WBPResponse + payload
+   * @param out Output buffer
+   * @param maxLen Buffer capacity
+   * @param cmd Command being answered
+   * @param status Result
+   * @param payload Optional payload (truncated to fit)
+   * @param payloadLen Payload length
+   * @return Bytes written
+   */
+  static size_t buildResponse(uint8_t *out, size_t maxLen, const Command &cmd,
+                              CommandStatus status,
+                              const uint8_t *payload = nullptr,
+                              size_t payloadLen = 0);
+
+  /**
+   * @brief Encode unsigned LEB128 varint
+   * @param value Value to encode
+   * @param out Output (at least 10 bytes)
+   * @return Bytes written
+   */
+  static size_t encodeVarint(uint64_t value, uint8_t *out);
+
+  /// @brief Map signed to unsigned so small magnitudes stay short
+  static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  }
+};
+
+/**
+ * @class DebugFrameWriter
+ * @brief Builds one binary telemetry notification
+ *
+ * Layout: [0xD1][flags][seq][count] then count x
+ * (varint index, zigzag varint raw delta).
+ */
+class DebugFrameWriter {
+public:
+  static constexpr size_t HEADER_SIZE = 4;
+
+  /**
+   * @param buffer Output buffer
+   * @param capacity Buffer size (transport MTU)
+   * @param seq Frame sequence number
+   * @param flags WBP_DEBUG_FLAG_*
+   */
+  DebugFrameWriter(uint8_t *buffer, size_t capacity, uint8_t seq,
+                   uint8_t flags);
+
+  /**
+   * @brief Append one entry
+   * @param index Signal index in the watch list
+   * @param delta Raw value minus last sent raw value
+   * @return false if the entry does not fit (frame unchanged)
+   */
+  bool add(uint16_t index, int64_t delta);
+
+  /// @brief Frame length in bytes
+  size_t size() const { return len_; }
+
+  /// @brief Number of entries
+  uint8_t count() const { return buffer_[3]; }
+
+private:
+  uint8_t *buffer_;
+  size_t capacity_;
+  size_t len_;
 };
 
 #pragma pack(push, 1)
@@ -90,6 +215,53 @@ struct WBPSignal {
   float offset;
 };
 
+struct WBPWatchHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t flags;
+  uint16_t signalCount;
+};
+
+struct WBPWatchPolicy {
+  uint16_t minIntervalMs;
+  uint8_t mode;
+  uint8_t aggregate;
+  float deadband;
+};
+
+struct WBPCommandHeader {
+  uint8_t opcode;
+  uint8_t requestId;
+};
+
+struct WBPStreamArgs {
+  uint32_t length;
+  uint32_t crc;
+};
+
+struct WBPCompressedArgs {
+  uint32_t length;    // Compressed stream size
+  uint32_t crc;       // CRC32 of the decompressed image
+  uint32_t imageSize; // Decompressed image size
+};
+
+struct WBPResumeArgs {
+  uint32_t sessionId;
+};
+
+struct WBPStreamPosition {
+  uint32_t sessionId;
+  uint32_t offset; // Highest contiguous byte received
+  uint32_t window; // Bytes the client may send beyond offset
+};
+
+struct WBPResponse {
+  uint8_t marker; // WBP_CMD_RESPONSE
+  uint8_t opcode;
+  uint8_t requestId;
+  uint8_t status;
+};
+
 struct WBPCondition {
   uint8_t signalIdx;
   uint8_t operation;
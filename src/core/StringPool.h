@@ -0,0 +1,86 @@
+/**
+ * @file StringPool.h
+ * @brief CORE:StringPool - Interned strings of one ruleset
+ * @version 1.0.0
+ *
+ * One contiguous buffer of NUL-terminated strings. A string is referred to
+ * by its 16-bit offset (its ID), so runtime structures hold a uint16_t
+ * instead of an Arduino String and stay trivially copyable. Identical
+ * strings are stored once. ID 0 is always the empty string.
+ *
+ * Filled while a ruleset loads, read-only afterwards.
+ */
+#pragma once
+#include "FixedVector.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace W4RP {
+
+#ifndef W4RP_MAX_STRING_BYTES
+#define W4RP_MAX_STRING_BYTES 1024 ///< Pool size (static-capacity builds)
+#endif
+
+/**
+ * @class StringPool
+ * @brief Append-only, deduplicating string buffer
+ */
+class StringPool {
+public:
+  static constexpr uint16_t EMPTY = 0;
+
+  StringPool() { clear(); }
+
+  /// @brief Drop all strings (ID 0 stays valid)
+  void clear() {
+    bytes_.clear();
+    bytes_.push_back('\0');
+  }
+
+  /**
+   * @brief Add a string, or find an identical one
+   * @param str Characters (need not be terminated)
+   * @param len Length
+   * @param id Output ID
+   * @return false if the pool is full
+   */
+  bool intern(const char *str, size_t len, uint16_t &id) {
+    if (len == 0) {
+      id = EMPTY;
+      return true;
+    }
+
+    // Load time only, pools are small: a linear scan is enough
+    for (size_t pos = 1; pos < bytes_.size();) {
+      size_t n = strlen(&bytes_[pos]);
+      if (n == len && memcmp(&bytes_[pos], str, len) == 0) {
+        id = pos;
+        return true;
+      }
+      pos += n + 1;
+    }
+
+    size_t pos = bytes_.size();
+    if (pos + len + 1 > 0xFFFF || !fitsCapacity(bytes_, pos + len + 1))
+      return false;
+
+    bytes_.insert(bytes_.end(), str, str + len);
+    bytes_.push_back('\0');
+    id = pos;
+    return true;
+  }
+
+  /// @brief String for an ID ("" if out of range)
+  const char *get(uint16_t id) const {
+    return id < bytes_.size() ? &bytes_[id] : "";
+  }
+
+  /// @brief Bytes used, including terminators
+  size_t size() const { return bytes_.size(); }
+
+private:
+  CapacityVector<char, W4RP_MAX_STRING_BYTES> bytes_;
+};
+
+} // namespace W4RP
@@ -8,7 +8,9 @@
  */
 #pragma once
 #include <Arduino.h>
-#include <functional>
+#include "FixedVector.h"
+#include "InplaceFunction.h"
+#include "StringPool.h"
 #include <map>
 #include <vector>
 
@@ -16,10 +18,47 @@ namespace W4RP {
 
 #define WBP_MAGIC_PROFILE 0xC0DE5701
 #define WBP_MAGIC_RULES 0xC0DE5702
+#define WBP_MAGIC_WATCH 0xC0DE5703
 #define WBP_VERSION 0x02
 #define WBP_MIN_VERSION 0x02
 #define WBP_FLAG_HAS_META 0x01
 #define WBP_FLAG_PERSIST 0x02
+#define WBP_WATCH_FLAG_POLICY 0x01
+#define WBP_DEBUG_FRAME 0xD1
+#define WBP_DEBUG_FLAG_KEY 0x01
+#define WBP_CMD_RESPONSE 0xD2
+
+// Ruleset / watch list limits. Enforced at load time when
+// W4RP_STATIC_CAPACITY is 1 (they size the fixed arrays); otherwise only
+// the WBP format limits apply.
+#ifndef W4RP_MAX_SIGNALS
+#define W4RP_MAX_SIGNALS 64
+#endif
+#ifndef W4RP_MAX_CONDITIONS
+#define W4RP_MAX_CONDITIONS 32 ///< Rule condition masks are 32-bit
+#endif
+#ifndef W4RP_MAX_ACTIONS
+#define W4RP_MAX_ACTIONS 32
+#endif
+#ifndef W4RP_MAX_ACTION_PARAMS
+#define W4RP_MAX_ACTION_PARAMS 64 ///< Per ruleset (shared by all actions)
+#endif
+#ifndef W4RP_MAX_RULES
+#define W4RP_MAX_RULES 32
+#endif
+#ifndef W4RP_MAX_DEBUG_SIGNALS
+#define W4RP_MAX_DEBUG_SIGNALS 64
+#endif
+#ifndef W4RP_MAX_RULESET_BYTES
+#define W4RP_MAX_RULESET_BYTES 4096
+#endif
+
+// 1: processCanFrame() only stores the payload per CAN ID; ruleset signals
+// are decoded when rules are evaluated, and only if the bytes changed.
+// 0: every matching frame decodes its signals immediately.
+#ifndef W4RP_LAZY_DECODE
+#define W4RP_LAZY_DECODE 1
+#endif
 
 /**
  * @enum Operation
@@ -43,9 +82,69 @@ enum class Operation : uint8_t {
  */
 enum class ParamType : uint8_t { INT = 0, FLOAT = 1, STRING = 2, BOOL = 3 };
 
+/**
+ * @enum CommandOp
+ * @brief Binary command opcodes (bit 7 set, never a text command byte)
+ */
+enum class CommandOp : uint8_t {
+  GET_PROFILE = 0x81,
+  GET_RULES = 0x82,
+  DEBUG_START = 0x83,
+  DEBUG_STOP = 0x84,
+  DEBUG_SYNC = 0x85,
+  DEBUG_WATCH = 0x86,   ///< + WBPStreamArgs
+  SET_RULES_RAM = 0x87, ///< + WBPStreamArgs
+  SET_RULES_NVS = 0x88, ///< + WBPStreamArgs
+  OTA_BEGIN = 0x89,     ///< + WBPStreamArgs
+  OTA_DELTA = 0x8A,     ///< + WBPStreamArgs (crc = source CRC)
+  OTA_CANCEL = 0x8B,
+  RESUME = 0x8C,     ///< + WBPResumeArgs
+  STREAM_ACK = 0x8D, ///< Response only: WBPStreamPosition
+  OTA_BEGIN_Z = 0x8E ///< + WBPCompressedArgs (zlib image)
+};
+
+#define WBP_CMD_COUNT 0x0F ///< Jump table size (opcode & 0x7F)
+
+/**
+ * @enum CommandStatus
+ * @brief Binary response status
+ */
+enum class CommandStatus : uint8_t {
+  OK = 0,
+  BUSY = 1,
+  BAD_ARGS = 2,
+  UNKNOWN = 3,
+  UNSUPPORTED = 4,
+  LEN_MISMATCH = 5,
+  CRC_FAIL = 6,
+  INVALID = 7,
+  CAP_UNKNOWN = 8,
+  NO_RULES = 9,
+  TOO_LARGE = 10,
+  FAILED = 11,
+  NO_SESSION = 12,
+  SOURCE_MISMATCH = 13,
+  BAD_SIGNATURE = 14,
+  DATA_LOST = 15
+};
+
+/**
+ * @struct Command
+ * @brief Decoded command (binary or text)
+ */
+struct Command {
+  CommandOp op = CommandOp::GET_PROFILE;
+  uint8_t requestId = 0;
+  bool binary = false; ///< Reply with WBP_CMD_RESPONSE, else legacy text
+  uint32_t length = 0; ///< Stream / image length
+  uint32_t crc = 0;    ///< Stream / image CRC
+  uint32_t session = 0; ///< RESUME session ID
+  uint32_t imageSize = 0; ///< OTA_BEGIN_Z decompressed size
+};
+
 /**
  * @struct RuntimeSignal
- * @brief CAN signal definition + runtime state
+ * @brief CAN signal definition (read-only after load, see SignalState)
  */
 struct RuntimeSignal {
   uint32_t canId;
@@ -55,11 +154,59 @@ struct RuntimeSignal {
   bool isSigned;
   float factor;
   float offset;
-  float value = 0.0f;
-  float lastValue = 0.0f;
-  float lastDebugValue = -999999.9f;
-  uint32_t lastUpdateMs = 0;
-  bool everSet = false;
+};
+
+/**
+ * @enum SampleMode
+ * @brief When a watched signal is sent
+ */
+enum class SampleMode : uint8_t {
+  ON_CHANGE = 0, ///< Moved more than deadband since last sent
+  PERIODIC = 1   ///< Every minIntervalMs, changed or not
+};
+
+/**
+ * @enum SampleAggregate
+ * @brief Value reported for the samples seen during one interval
+ */
+enum class SampleAggregate : uint8_t { LAST = 0, MIN = 1, MAX = 2, AVG = 3 };
+
+/**
+ * @struct SamplePolicy
+ * @brief Per-signal debug watch policy
+ */
+struct SamplePolicy {
+  uint16_t minIntervalMs = 0; ///< Never send more often than this
+  float deadband = 0.01f;     ///< ON_CHANGE threshold (physical units)
+  SampleMode mode = SampleMode::ON_CHANGE;
+  SampleAggregate aggregate = SampleAggregate::LAST;
+};
+
+/**
+ * @struct DebugSignal
+ * @brief Watched signal + telemetry state
+ *
+ * Values are sent as raw (pre factor/offset) integers, delta encoded
+ * against the last value sent for the same index.
+ */
+struct DebugSignal {
+  RuntimeSignal sig;
+  SamplePolicy policy;
+  int64_t raw = 0;         ///< Latest raw value
+  bool sampled = false;    ///< raw is valid (received since WATCH)
+  int64_t lastSentRaw = 0; ///< Baseline for the next delta
+  uint32_t lastSentMs = 0;
+  bool sent = false;       ///< Sent since WATCH / SYNC
+  int16_t rulesetIdx = -1; ///< Ruleset signal decoding the same bits
+  int16_t primaryIdx = -1; ///< Earlier watch entry decoding the same bits
+  int16_t nextLinked = -1; ///< Next watch entry sharing the same decode
+
+  // Aggregation over the current interval
+  uint32_t windowStartMs = 0;
+  int64_t aggMin = 0;
+  int64_t aggMax = 0;
+  int64_t aggSum = 0;
+  uint32_t aggCount = 0;
 };
 
 /**
@@ -71,6 +218,14 @@ struct RuntimeCondition {
   Operation operation;
   float value1;
   float value2;
+
+  // Raw-domain form, set at load when the signal's scaling is exact integer
+  // math: holds when rawLo <= raw <= rawHi (rawInside) or outside it
+  bool rawDomain = false;
+  bool rawInside = true;
+  int64_t rawLo = 0;
+  int64_t rawHi = 0;
+
   uint32_t holdMs = 0;
   uint32_t holdStartMs = 0;
   bool holdActive = false;
@@ -86,17 +241,39 @@ struct RuntimeParam {
   union {
     int32_t intVal;
     float floatVal;
+    uint16_t strId; ///< STRING: ID in the ruleset's StringPool
   };
-  String strVal;
 };
 
 /**
  * @struct RuntimeAction
- * @brief Action with capability ID and parameters
+ * @brief Action with capability ID and parameter range
  */
 struct RuntimeAction {
-  String capabilityId;
-  std::vector<RuntimeParam> params;
+  uint16_t capabilityStrId;   ///< Capability ID in the ruleset's StringPool
+  uint16_t capabilityIdx = 0; ///< Resolved by Engine::loadRuleset()
+  uint8_t paramStart;         ///< First entry in the ruleset's ParamTable
+  uint8_t paramCount;
+};
+
+/**
+ * @struct ActionArgs
+ * @brief Parameters of one action execution (a view, valid during the call)
+ */
+struct ActionArgs {
+  const RuntimeParam *params;
+  size_t count;
+  const StringPool *strings;
+
+  /// nullptr past the end (missing optional params)
+  const RuntimeParam *at(size_t i) const {
+    return i < count ? &params[i] : nullptr;
+  }
+
+  /// Text of a STRING param ("" for other types)
+  const char *text(const RuntimeParam &p) const {
+    return p.type == ParamType::STRING ? strings->get(p.strId) : "";
+  }
 };
 
 /**
@@ -114,6 +291,74 @@ struct RuntimeRule {
   bool lastConditionState = false;
 };
 
+using SignalList = CapacityVector<RuntimeSignal, W4RP_MAX_SIGNALS>;
+
+/**
+ * @struct FrameSlot
+ * @brief Latest payload of one ruleset CAN ID (W4RP_LAZY_DECODE)
+ */
+struct FrameSlot {
+  uint32_t canId;
+  uint32_t rxMs = 0;    ///< Last received, changed or not
+  uint32_t version = 0; ///< Bumped when the bytes change, 0 = never received
+  uint8_t data[8] = {};
+};
+
+/**
+ * @struct SignalState
+ * @brief Ruleset signal values, struct-of-arrays (index = signal index)
+ *
+ * Kept apart from the RuntimeSignal definitions so condition evaluation
+ * reads contiguous floats and one validity bit per signal.
+ */
+struct SignalState {
+  CapacityVector<int64_t, W4RP_MAX_SIGNALS> raw;
+  CapacityVector<float, W4RP_MAX_SIGNALS> value; ///< Scaled signals only
+  CapacityVector<uint32_t, W4RP_MAX_SIGNALS> updatedMs;
+  CapacityVector<uint32_t, (W4RP_MAX_SIGNALS + 31) / 32> validBits;
+  CapacityVector<uint32_t, (W4RP_MAX_SIGNALS + 31) / 32> scaledBits;
+
+  /// @brief n signals, none received yet, none scaled
+  void reset(size_t n) {
+    raw.assign(n, 0);
+    value.assign(n, 0.0f);
+    updatedMs.assign(n, 0);
+    validBits.assign((n + 31) / 32, 0);
+    scaledBits.assign((n + 31) / 32, 0);
+  }
+
+  size_t size() const { return raw.size(); }
+
+  /// @brief Received at least once since load
+  bool isValid(size_t i) const {
+    return (validBits[i >> 5] >> (i & 31)) & 1u;
+  }
+
+  /// @brief value[i] is kept up to date (a float condition reads it)
+  bool isScaled(size_t i) const {
+    return (scaledBits[i >> 5] >> (i & 31)) & 1u;
+  }
+
+  void setScaled(size_t i) { scaledBits[i >> 5] |= 1u << (i & 31); }
+
+  void set(size_t i, int64_t r, uint32_t nowMs) {
+    raw[i] = r;
+    updatedMs[i] = nowMs;
+    validBits[i >> 5] |= 1u << (i & 31);
+  }
+};
+using ConditionList = CapacityVector<RuntimeCondition, W4RP_MAX_CONDITIONS>;
+using ActionList = CapacityVector<RuntimeAction, W4RP_MAX_ACTIONS>;
+using ParamTable = CapacityVector<RuntimeParam, W4RP_MAX_ACTION_PARAMS>;
+
+// Ruleset tables are plain data: copied and moved as bytes, no heap
+static_assert(std::is_trivially_copyable<RuntimeParam>::value &&
+                  std::is_trivially_copyable<RuntimeAction>::value,
+              "Action tables must stay trivially copyable");
+using RuleList = CapacityVector<RuntimeRule, W4RP_MAX_RULES>;
+using DebugSignalList = CapacityVector<DebugSignal, W4RP_MAX_DEBUG_SIGNALS>;
+using RulesetBinary = CapacityVector<uint8_t, W4RP_MAX_RULESET_BYTES>;
+
 /**
  * @struct CapabilityParamMeta
  * @brief Parameter metadata for profile
@@ -140,6 +385,6 @@ struct CapabilityMeta {
 };
 
 using ParamMap = std::map<String, String>;
-using CapabilityHandler = std::function<void(const ParamMap &)>;
+using CapabilityHandler = InplaceFunction<void(const ParamMap &)>;
 
 } // namespace W4RP
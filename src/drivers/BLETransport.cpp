@@ -10,6 +10,8 @@ static const char *TAG = "BLETransport";
 
 namespace W4RP {
 
+BLETransport *BLETransport::instance_ = nullptr;
+
 BLETransport::BLETransport() {}
 
 BLETransport::~BLETransport() {
@@ -24,7 +26,12 @@ bool BLETransport::begin(const char *deviceName) {
 
   // Initialize BLE
   BLEDevice::init(deviceName);
-  BLEDevice::setMTU(247);
+  BLEDevice::setMTU(W4RP_BLE_MTU);
+
+  // Track DLE / PHY results and congestion (single transport per device)
+  instance_ = this;
+  BLEDevice::setCustomGapHandler(gapHandler);
+  BLEDevice::setCustomGattsHandler(gattsHandler);
 
   // Create server
   server_ = BLEDevice::createServer();
@@ -73,6 +80,12 @@ void BLETransport::startAdvertising() {
 }
 
 void BLETransport::onConnect(BLEServer *server) {
+  // The TX queue is reset by loop() when it sees the new generation; only
+  // atomics are touched from the BLE task
+  txCongested_ = false;
+  txBackoffUntilUs_ = 0;
+  txCredits_ = W4RP_BLE_TX_BURST;
+  connGeneration_.fetch_add(1);
   connected_ = true;
   ESP_LOGI(TAG, "Client connected");
 
@@ -81,8 +94,84 @@ void BLETransport::onConnect(BLEServer *server) {
   }
 }
 
+void BLETransport::onConnect(BLEServer *server,
+                             esp_ble_gatts_cb_param_t *param) {
+  mtu_ = W4RP_BLE_DEFAULT_MTU;
+  dataLen_ = 27;
+  phy2M_ = false;
+
+  // Ask for larger LL packets; ignored if the central can't do DLE
+  esp_ble_gap_set_pkt_data_len(param->connect.remote_bda, W4RP_BLE_DATA_LEN);
+
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+  // Prefer 2M PHY; the controller falls back to 1M if unsupported
+  esp_ble_gap_set_prefered_phy(
+      param->connect.remote_bda, ESP_BLE_GAP_NO_PREFER_TRANSMIT_PHY,
+      ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+      ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+}
+
+void BLETransport::onMtuChanged(BLEServer *server,
+                                esp_ble_gatts_cb_param_t *param) {
+  mtu_ = param->mtu.mtu;
+  ESP_LOGI(TAG, "MTU negotiated: %u", param->mtu.mtu);
+}
+
+void BLETransport::gapHandler(esp_gap_ble_cb_event_t event,
+                              esp_ble_gap_cb_param_t *param) {
+  if (!instance_)
+    return;
+
+  switch (event) {
+  case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+    if (param->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+      instance_->dataLen_ = param->pkt_data_length_cmpl.params.tx_len;
+      ESP_LOGI(TAG, "Data length: %u",
+               param->pkt_data_length_cmpl.params.tx_len);
+    }
+    break;
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+  case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
+    if (param->phy_update.status == ESP_BT_STATUS_SUCCESS) {
+      bool phy2M = (param->phy_update.tx_phy == ESP_BLE_GAP_PHY_2M);
+      instance_->phy2M_ = phy2M;
+      ESP_LOGI(TAG, "PHY: %s", phy2M ? "2M" : "1M");
+    }
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+void BLETransport::gattsHandler(esp_gatts_cb_event_t event,
+                                esp_gatt_if_t gattsIf,
+                                esp_ble_gatts_cb_param_t *param) {
+  if (!instance_)
+    return;
+
+  if (event == ESP_GATTS_CONF_EVT) {
+    // The stack is done with one TX notification: its credit comes back
+    BLECharacteristic *txChar = instance_->txChar_;
+    if (txChar && param->conf.handle == txChar->getHandle())
+      instance_->returnCredit();
+  } else if (event == ESP_GATTS_CONGEST_EVT) {
+    // The stack's notification buffers filled up or drained
+    bool congested = param->congest.congested;
+    instance_->txCongested_ = congested;
+    if (!congested) {
+      instance_->txBackoffUntilUs_ = 0;
+      instance_->txCredits_ = W4RP_BLE_TX_BURST;
+    }
+    ESP_LOGD(TAG, "TX %s", congested ? "congested" : "uncongested");
+  }
+}
+
 void BLETransport::onDisconnect(BLEServer *server) {
   connected_ = false;
+  txCongested_ = false;
+  mtu_ = W4RP_BLE_DEFAULT_MTU;
   lastDisconnectMs_ = millis();
   ESP_LOGI(TAG, "Client disconnected");
 
@@ -104,24 +193,113 @@ void BLETransport::onWrite(BLECharacteristic *characteristic) {
   }
 }
 
+bool BLETransport::txBlocked() const {
+  if (txCongested_)
+    return true;
+  uint32_t until = txBackoffUntilUs_;
+  return until != 0 && (int32_t)(micros() - until) < 0;
+}
+
+size_t BLETransport::txCredits() const {
+  if (!connected_ || txQueue_.size() > 0 || txBlocked())
+    return 0;
+  return txCredits_;
+}
+
+bool BLETransport::takeCredit() {
+  if (txBlocked())
+    return false;
+
+  uint8_t credits = txCredits_;
+  while (credits > 0 &&
+         !txCredits_.compare_exchange_weak(credits, credits - 1)) {
+  }
+  return credits > 0;
+}
+
+void BLETransport::returnCredit() {
+  uint8_t credits = txCredits_;
+  while (credits < W4RP_BLE_TX_BURST &&
+         !txCredits_.compare_exchange_weak(credits, credits + 1)) {
+  }
+}
+
+void BLETransport::notify(const uint8_t *data, size_t len) {
+  txChar_->setValue((uint8_t *)data, len);
+  txChar_->notify();
+}
+
 void BLETransport::send(const uint8_t *data, size_t len) {
-  if (!connected_ || !txChar_)
+  if (!connected_ || !txChar_ || len == 0)
     return;
 
-  // Chunk if needed
   size_t mtu = getMTU();
-  size_t offset = 0;
+  if (mtu > W4RP_BLE_TX_SLOT_SIZE)
+    mtu = W4RP_BLE_TX_SLOT_SIZE;
+  size_t chunks = (len + mtu - 1) / mtu;
+
+  // Straight to the stack while credits last and nothing is queued ahead
+  size_t direct = 0;
+  size_t credits = txCredits_;
+  if (txQueue_.size() == 0 && !txBlocked())
+    direct = (credits < chunks) ? credits : chunks;
+
+  // The rest waits for loop(). A reply that does not fit is dropped
+  // whole rather than cut short.
+  if (chunks - direct > W4RP_BLE_TX_QUEUE_SLOTS - txQueue_.size()) {
+    txDropped_++;
+    ESP_LOGW(TAG, "TX queue full, %u-byte send dropped", (unsigned)len);
+    return;
+  }
 
+  // takeCredit() per chunk: a notify that fails mid-send blocks the rest,
+  // which then queue behind it
+  bool queued = txQueue_.size() > 0;
+  size_t offset = 0;
   while (offset < len) {
     size_t chunkLen = (len - offset > mtu) ? mtu : (len - offset);
-    txChar_->setValue((uint8_t *)(data + offset), chunkLen);
-    txChar_->notify();
+    if (!queued && takeCredit()) {
+      notify(data + offset, chunkLen);
+    } else {
+      queued = true;
+      if (!txQueue_.push(data + offset, chunkLen)) {
+        txDropped_++;
+        return;
+      }
+    }
     offset += chunkLen;
+  }
+}
 
-    // Small delay between chunks to prevent overflow
-    if (offset < len) {
-      delay(5);
-    }
+void BLETransport::drainQueue() {
+  PacketRing<W4RP_BLE_TX_QUEUE_SLOTS, W4RP_BLE_TX_SLOT_SIZE>::Packet pkt;
+  while (txQueue_.front(pkt) && takeCredit()) {
+    notify(pkt.data, pkt.len);
+    txQueue_.pop();
+  }
+}
+
+void BLETransport::dropQueued() {
+  PacketRing<W4RP_BLE_TX_QUEUE_SLOTS, W4RP_BLE_TX_SLOT_SIZE>::Packet pkt;
+  while (txQueue_.front(pkt))
+    txQueue_.pop();
+}
+
+void BLETransport::onStatus(BLECharacteristic *characteristic, Status status,
+                            uint32_t code) {
+  if (characteristic != txChar_)
+    return;
+
+  // Any refused notification never reached the stack: no ESP_GATTS_CONF_EVT
+  // will return its credit
+  if (status != Status::SUCCESS_NOTIFY && status != Status::SUCCESS_INDICATE)
+    returnCredit();
+
+  if (status == Status::ERROR_GATT || status == Status::ERROR_NO_CLIENT) {
+    // Stop sending until the backoff ends or the stack reports uncongested
+    uint32_t until = micros() + W4RP_BLE_TX_BACKOFF_US;
+    txBackoffUntilUs_ = until ? until : 1;
+    ESP_LOGD(TAG, "Notify failed (%u), backing off", code);
   }
 }
 
@@ -137,6 +315,23 @@ void BLETransport::loop() {
   if (!initialized_)
     return;
 
+  // New connection or link lost: chunks queued for the old one are stale
+  uint32_t generation = connGeneration_;
+  if (generation != seenGeneration_ || !connected_) {
+    seenGeneration_ = generation;
+    dropQueued();
+  }
+
+  // A backoff the stack never ended expires here. Only cleared if
+  // onStatus() did not set a new one meanwhile.
+  uint32_t until = txBackoffUntilUs_;
+  if (until != 0 && (int32_t)(micros() - until) >= 0)
+    txBackoffUntilUs_.compare_exchange_strong(until, 0);
+
+  // Queued chunks go out on the credits the stack has returned
+  if (connected_)
+    drainQueue();
+
   // Restart advertising after disconnect (with delay)
   if (!connected_ && lastDisconnectMs_ > 0) {
     if (millis() - lastDisconnectMs_ > 1000) {
@@ -147,9 +342,16 @@ void BLETransport::loop() {
 }
 
 size_t BLETransport::getMTU() const {
-  // Safe chunk size for notifications
-  // ESP32 negotiates up to 247, but we use 128 for safety
-  return 128;
+  // Notification payload = ATT MTU - 3 (opcode + handle)
+  return mtu_ - 3;
+}
+
+BLELinkStats BLETransport::getLinkStats() const {
+  BLELinkStats stats;
+  stats.mtu = mtu_;
+  stats.dataLen = dataLen_;
+  stats.phy2M = phy2M_;
+  return stats;
 }
 
 } // namespace W4RP
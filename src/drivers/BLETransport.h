@@ -10,11 +10,15 @@
  *   Status: 0000fff3-... (Notify)
  */
 #pragma once
+#include "../core/PacketRing.h"
 #include "../interfaces/Communication.h"
 #include <BLE2902.h>
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
+#include <atomic>
+#include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
 
 namespace W4RP {
 
@@ -23,6 +27,33 @@ namespace W4RP {
 #define W4RP_TX_UUID "0000fff2-5734-5250-5734-525000000000"
 #define W4RP_STATUS_UUID "0000fff3-5734-5250-5734-525000000000"
 
+/// ATT MTU requested from the central
+#define W4RP_BLE_MTU 247
+/// LL data length requested (DLE); 251 fits one 244-byte notification
+#define W4RP_BLE_DATA_LEN 251
+/// ATT MTU before exchange (Bluetooth Core spec minimum)
+#define W4RP_BLE_DEFAULT_MTU 23
+
+/// Notifications handed to the stack and not yet confirmed by it
+#define W4RP_BLE_TX_BURST 6
+/// Pause after a failed notification, unless the stack reports
+/// uncongested first
+#define W4RP_BLE_TX_BACKOFF_US 20000
+/// Notifications send() can hold while the stack is congested (power of 2)
+#define W4RP_BLE_TX_QUEUE_SLOTS 8
+/// Largest notification payload (W4RP_BLE_MTU - 3)
+#define W4RP_BLE_TX_SLOT_SIZE (W4RP_BLE_MTU - 3)
+
+/**
+ * @struct BLELinkStats
+ * @brief Parameters negotiated for the current connection
+ */
+struct BLELinkStats {
+  uint16_t mtu = W4RP_BLE_DEFAULT_MTU; ///< ATT MTU
+  uint16_t dataLen = 27;               ///< LL TX payload octets
+  bool phy2M = false;                  ///< 2M PHY active
+};
+
 /**
  * @class BLETransport
  * @brief ESP32 BLE transport driver
@@ -48,7 +79,9 @@ public:
   bool isConnected() const override { return connected_; }
 
   /**
-   * @brief Send via TX characteristic (chunked)
+   * @brief Send via TX characteristic (chunked, one credit per chunk)
+   * Never waits: chunks without a credit are queued and sent by loop().
+   * A send that does not fit the queue is dropped whole.
    * @param data Data buffer
    * @param len Data length
    */
@@ -78,19 +111,41 @@ public:
   }
 
   /**
-   * @brief Restart advertising after disconnect
+   * @brief Send queued chunks, restart advertising
    */
   void loop() override;
 
   /**
-   * @brief Get MTU size
-   * @return 128 (safe chunk size)
+   * @brief Get notification payload size for this connection
+   * @return Negotiated ATT MTU - 3
    */
   size_t getMTU() const override;
 
+  /**
+   * @brief Get negotiated link parameters
+   * @return MTU, data length, PHY
+   */
+  BLELinkStats getLinkStats() const;
+
+  /**
+   * @brief Notifications the stack can take now
+   * One credit per notification, returned when the stack confirms it
+   * (ESP_GATTS_CONF_EVT); all restored when it reports uncongested.
+   * @return 0..W4RP_BLE_TX_BURST (0 while congested or chunks are queued)
+   */
+  size_t txCredits() const override;
+
+  /// @brief Sends dropped because the TX queue was full
+  uint32_t getTxDropped() const { return txDropped_; }
+
   void onConnect(BLEServer *server) override;
+  void onConnect(BLEServer *server, esp_ble_gatts_cb_param_t *param) override;
   void onDisconnect(BLEServer *server) override;
+  void onMtuChanged(BLEServer *server,
+                    esp_ble_gatts_cb_param_t *param) override;
   void onWrite(BLECharacteristic *characteristic) override;
+  void onStatus(BLECharacteristic *characteristic, Status status,
+                uint32_t code) override;
 
 private:
   BLEServer *server_ = nullptr;
@@ -102,12 +157,38 @@ private:
   TransportRxCallback rxCallback_;
   TransportConnCallback connCallback_;
 
-  bool connected_ = false;
   bool initialized_ = false;
   uint32_t lastDisconnectMs_ = 0;
   String deviceName_;
 
+  // Written from BLE stack callbacks, read by loop()
+  std::atomic<bool> connected_{false};
+  std::atomic<uint32_t> connGeneration_{0}; ///< Bumped on every connect
+  std::atomic<bool> txCongested_{false};    ///< ESP_GATTS_CONGEST_EVT
+  std::atomic<uint32_t> txBackoffUntilUs_{0}; ///< 0 = no backoff
+  std::atomic<uint8_t> txCredits_{W4RP_BLE_TX_BURST}; ///< Taken by loop()
+  std::atomic<uint16_t> mtu_{W4RP_BLE_DEFAULT_MTU};
+  std::atomic<uint16_t> dataLen_{27};
+  std::atomic<bool> phy2M_{false};
+
+  // loop() task only
+  uint32_t seenGeneration_ = 0;
+  uint32_t txDropped_ = 0;
+  PacketRing<W4RP_BLE_TX_QUEUE_SLOTS, W4RP_BLE_TX_SLOT_SIZE> txQueue_;
+
+  static BLETransport *instance_;
+  static void gapHandler(esp_gap_ble_cb_event_t event,
+                         esp_ble_gap_cb_param_t *param);
+  static void gattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf,
+                           esp_ble_gatts_cb_param_t *param);
+
   void startAdvertising();
+  bool txBlocked() const;
+  bool takeCredit();
+  void returnCredit();
+  void notify(const uint8_t *data, size_t len);
+  void drainQueue();
+  void dropQueued();
 };
 
 } // namespace W4RP
@@ -0,0 +1,181 @@
+/**
+ * @file CachedStorage.cpp
+ * @brief Write-behind storage cache implementation
+ */
+
+#include "CachedStorage.h"
+#include <esp_log.h>
+
+static const char *TAG = "CachedStorage";
+
+namespace W4RP {
+
+CachedStorage::CachedStorage(Storage *backing,
+                             const CachedStorageConfig &config)
+    : backing_(backing), config_(config) {}
+
+CachedStorage::~CachedStorage() { commit(); }
+
+bool CachedStorage::begin() {
+  if (!backing_->begin())
+    return false;
+
+  backing_->setAutoCommit(false);
+  return true;
+}
+
+bool CachedStorage::stage(const char *key, EntryKind kind,
+                          const uint8_t *data, size_t len) {
+  String k(key);
+  auto it = pending_.find(k);
+
+  if (it != pending_.end()) {
+    // Coalesce: identical rewrite costs nothing
+    if (it->second.kind == kind && it->second.data.size() == len &&
+        (len == 0 || memcmp(it->second.data.data(), data, len) == 0)) {
+      stats_.writes++;
+      return true;
+    }
+    pendingBytes_ -= it->second.data.size();
+  } else {
+    it = pending_.emplace(k, Entry{kind, 0, {}}).first;
+  }
+
+  it->second.kind = kind;
+  it->second.failures = 0; // New value, new attempts
+  it->second.data.assign(data, data + len);
+  pendingBytes_ += len;
+
+  if (writesSinceFlush_ == 0)
+    firstDirtyMs_ = millis();
+  writesSinceFlush_++;
+  stats_.writes++;
+
+  if (pendingBytes_ >= config_.flushThresholdBytes)
+    return commit();
+
+  return true;
+}
+
+bool CachedStorage::writeBlob(const char *key, const uint8_t *data,
+                              size_t len) {
+  return stage(key, EntryKind::BLOB, data, len);
+}
+
+bool CachedStorage::writeString(const char *key, const String &value) {
+  return stage(key, EntryKind::STRING,
+               reinterpret_cast<const uint8_t *>(value.c_str()),
+               value.length());
+}
+
+bool CachedStorage::erase(const char *key) {
+  return stage(key, EntryKind::ERASED, nullptr, 0);
+}
+
+size_t CachedStorage::readBlob(const char *key, uint8_t *buffer,
+                               size_t maxLen) {
+  auto it = pending_.find(String(key));
+  if (it == pending_.end())
+    return backing_->readBlob(key, buffer, maxLen);
+
+  const Entry &e = it->second;
+  if (e.kind != EntryKind::BLOB)
+    return 0;
+
+  if (buffer == nullptr)
+    return e.data.size();
+
+  size_t readLen = (e.data.size() > maxLen) ? maxLen : e.data.size();
+  memcpy(buffer, e.data.data(), readLen);
+  return readLen;
+}
+
+String CachedStorage::readString(const char *key) {
+  auto it = pending_.find(String(key));
+  if (it == pending_.end())
+    return backing_->readString(key);
+
+  const Entry &e = it->second;
+  if (e.kind != EntryKind::STRING)
+    return String();
+
+  return String(reinterpret_cast<const char *>(e.data.data()), e.data.size());
+}
+
+bool CachedStorage::commit() {
+  if (pending_.empty())
+    return true;
+
+  bool ok = true;
+  size_t flushed = 0;
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    const char *key = it->first.c_str();
+    Entry &e = it->second;
+    bool written = false;
+
+    switch (e.kind) {
+    case EntryKind::BLOB:
+      written = backing_->writeBlob(key, e.data.data(), e.data.size());
+      break;
+    case EntryKind::STRING: {
+      String value(reinterpret_cast<const char *>(e.data.data()),
+                   e.data.size());
+      written = backing_->writeString(key, value);
+      break;
+    }
+    case EntryKind::ERASED:
+      written = backing_->erase(key);
+      break;
+    }
+
+    if (!written) {
+      ok = false;
+      if (++e.failures < config_.maxWriteAttempts) {
+        ++it; // Keep entry dirty, retry on next flush
+        continue;
+      }
+      // Permanent failure (e.g. partition full): stop retrying
+      ESP_LOGE(TAG, "Dropping '%s' after %u failed writes", key,
+               (unsigned)e.failures);
+      stats_.writesDropped++;
+    } else {
+      stats_.bytesWritten += e.data.size();
+      flushed++;
+    }
+
+    pendingBytes_ -= e.data.size();
+    it = pending_.erase(it);
+  }
+
+  // Nothing landed: no backing commit, nothing to count
+  if (flushed > 0) {
+    if (backing_->commit()) {
+      stats_.commits++;
+      if (writesSinceFlush_ > 1)
+        stats_.commitsAvoided += writesSinceFlush_ - 1;
+    } else {
+      ok = false;
+    }
+  }
+
+  writesSinceFlush_ = pending_.empty() ? 0 : 1;
+  firstDirtyMs_ = millis();
+
+  return ok;
+}
+
+void CachedStorage::loop() {
+  if (pending_.empty())
+    return;
+
+  if (millis() - firstDirtyMs_ >= config_.flushIntervalMs)
+    commit();
+}
+
+CachedStorageStats CachedStorage::getStats() const {
+  CachedStorageStats stats = stats_;
+  stats.pendingBytes = pendingBytes_;
+  return stats;
+}
+
+} // namespace W4RP
@@ -0,0 +1,150 @@
+/**
+ * @file CachedStorage.h
+ * @brief DRIVERS:CachedStorage - Write-behind storage cache
+ * @version 1.0.0
+ *
+ * Wraps any Storage driver and batches writes in RAM. Dirty keys are
+ * flushed with a single commit when the flush interval elapses, when the
+ * pending byte threshold is reached, or on an explicit commit()
+ * (Controller calls it before OTA and reboot).
+ *
+ * @code
+ * NVSStorage nvs;
+ * CachedStorage storage(&nvs);
+ * Controller w4rp(&canBus, &storage, &transport);
+ * @endcode
+ */
+#pragma once
+#include "../interfaces/Storage.h"
+#include <map>
+#include <vector>
+
+namespace W4RP {
+
+/**
+ * @struct CachedStorageConfig
+ * @brief Flush policy
+ */
+struct CachedStorageConfig {
+  uint32_t flushIntervalMs = 10000; ///< Max age of the oldest dirty write
+  size_t flushThresholdBytes = 2048; ///< Flush once this many bytes pend
+  uint8_t maxWriteAttempts = 3; ///< Flushes a failing key is tried in
+};
+
+/**
+ * @struct CachedStorageStats
+ * @brief Write-behind counters
+ */
+struct CachedStorageStats {
+  uint32_t writes = 0;         ///< write/erase calls accepted
+  uint32_t commits = 0;        ///< Successful backing commits
+  uint32_t commitsAvoided = 0; ///< Commits saved versus auto-commit
+  uint32_t bytesWritten = 0;   ///< Bytes handed to the backing driver
+  uint32_t pendingBytes = 0;   ///< Bytes waiting for the next flush
+  uint32_t writesDropped = 0;  ///< Keys given up after maxWriteAttempts
+};
+
+/**
+ * @class CachedStorage
+ * @brief Write-coalescing decorator for a Storage driver
+ */
+class CachedStorage : public Storage {
+public:
+  /**
+   * @brief Construct around a backing driver
+   * @param backing Storage to flush into (not owned)
+   * @param config Flush policy
+   */
+  explicit CachedStorage(Storage *backing,
+                         const CachedStorageConfig &config = {});
+
+  /// @brief Flushes pending writes
+  ~CachedStorage();
+
+  /**
+   * @brief Begin backing driver, disable its auto-commit
+   * @return true on success
+   */
+  bool begin() override;
+
+  /**
+   * @brief Stage blob for the next flush
+   * @param key Storage key
+   * @param data Data buffer
+   * @param len Data length
+   * @return true if staged (or flushed when over threshold)
+   */
+  bool writeBlob(const char *key, const uint8_t *data, size_t len) override;
+
+  /**
+   * @brief Read blob, pending value first
+   * @param key Storage key
+   * @param buffer Output buffer (nullptr = size query)
+   * @param maxLen Buffer capacity
+   * @return Bytes read
+   */
+  size_t readBlob(const char *key, uint8_t *buffer, size_t maxLen) override;
+
+  /**
+   * @brief Stage string for the next flush
+   * @param key Storage key
+   * @param value String value
+   * @return true if staged
+   */
+  bool writeString(const char *key, const String &value) override;
+
+  /**
+   * @brief Read string, pending value first
+   * @param key Storage key
+   * @return String value or empty
+   */
+  String readString(const char *key) override;
+
+  /**
+   * @brief Stage key deletion for the next flush
+   * @param key Storage key
+   * @return true if staged
+   */
+  bool erase(const char *key) override;
+
+  /**
+   * @brief Flush all dirty keys with one backing commit
+   * A key whose backing write fails stays dirty for the next flush and is
+   * dropped (and logged) after maxWriteAttempts failed flushes.
+   * @return true if everything was written
+   */
+  bool commit() override;
+
+  /**
+   * @brief Flush when the interval has elapsed
+   */
+  void loop() override;
+
+  /// @brief Get write-behind counters
+  CachedStorageStats getStats() const;
+
+  /// @brief Check for unflushed writes
+  bool isDirty() const { return !pending_.empty(); }
+
+private:
+  enum class EntryKind : uint8_t { BLOB, STRING, ERASED };
+
+  struct Entry {
+    EntryKind kind;
+    uint8_t failures; // Failed flushes of this value
+    std::vector<uint8_t> data;
+  };
+
+  Storage *backing_;
+  CachedStorageConfig config_;
+  std::map<String, Entry> pending_;
+  size_t pendingBytes_ = 0;
+  uint32_t firstDirtyMs_ = 0;
+  uint32_t writesSinceFlush_ = 0;
+  CachedStorageStats stats_;
+
+  bool stage(const char *key, EntryKind kind, const uint8_t *data,
+             size_t len);
+};
+
+} // namespace W4RP
@@ -2,12 +2,13 @@
  * @file ESP32OTAService.cpp
  * @brief ESP32 OTA service implementation
  *
- * Full firmware: Direct write to OTA partition
- * Delta update: Ring buffer + background janpatch task
+ * Full firmware: 4 KB double-buffered blocks, flash writes in writer task
+ * Delta update: Ring buffer + janpatch task running during upload
  */
 
 #include "ESP32OTAService.h"
 #include <esp_crc.h>
+#include <esp_image_format.h>
 #include <esp_log.h>
 #include <esp_partition.h>
 
@@ -30,14 +31,15 @@ struct OtaStream {
   esp_ota_handle_t otaHandle;
   RingbufHandle_t ringBuffer;
   long offset;
+  long limit;                 // Patch: total size (EOF)
+  volatile bool *cancel;      // Patch: abort() requested
+  SignatureVerifier *verifier; // Target: hash written image (signed only)
   bool isSource; // Reading from running partition
   bool isPatch;  // Reading from ring buffer
   bool isTarget; // Writing to OTA partition
 
-  // Page cache for source partition reads
-  uint8_t *pageCache;
-  uint32_t cachedPage;
-  bool cacheValid;
+  // LRU cache for source partition reads
+  PageCache *cache;
 };
 
 #define JANPATCH_PAGE_SIZE 1024
@@ -51,47 +53,83 @@ static size_t ota_fread(void *ptr, size_t size, size_t count, FILE *stream) {
   size_t total = size * count;
 
   if (s->isSource) {
-    // Read from running partition with page caching
-    uint32_t pageIdx = s->offset / JANPATCH_PAGE_SIZE;
-
-    if (!s->cacheValid || s->cachedPage != pageIdx) {
-      // Load new page
-      esp_err_t err =
-          esp_partition_read(s->partition, pageIdx * JANPATCH_PAGE_SIZE,
-                             s->pageCache, JANPATCH_PAGE_SIZE);
-      if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Source read failed at 0x%lx", s->offset);
-        return 0;
-      }
-      s->cachedPage = pageIdx;
-      s->cacheValid = true;
+    // Read from running partition through the LRU cache
+    size_t read = s->cache->read(s->offset, (uint8_t *)ptr, total);
+    if (read < total) {
+      ESP_LOGW(TAG, "Short source read at 0x%lx", s->offset);
     }
-
-    // Copy from cache
-    uint32_t pageOffset = s->offset % JANPATCH_PAGE_SIZE;
-    size_t available = JANPATCH_PAGE_SIZE - pageOffset;
-    size_t toCopy = (total > available) ? available : total;
-    memcpy(ptr, s->pageCache + pageOffset, toCopy);
-    s->offset += toCopy;
-    return toCopy / size;
+    s->offset += read;
+    return read / size;
   }
 
   if (s->isPatch) {
-    // Read from ring buffer
-    size_t itemSize;
-    void *item = xRingbufferReceiveUpTo(s->ringBuffer, &itemSize, 0, total);
-    if (item == nullptr) {
-      return 0;
+    // Read from ring buffer, waiting for bytes still in flight.
+    // EOF only once the whole patch has been consumed.
+    size_t done = 0;
+    while (done < total && s->offset < s->limit && !*s->cancel) {
+      size_t want = total - done;
+      if ((long)want > s->limit - s->offset)
+        want = s->limit - s->offset;
+
+      size_t itemSize;
+      void *item = xRingbufferReceiveUpTo(s->ringBuffer, &itemSize,
+                                          pdMS_TO_TICKS(50), want);
+      if (item == nullptr)
+        continue;
+
+      memcpy((uint8_t *)ptr + done, item, itemSize);
+      vRingbufferReturnItem(s->ringBuffer, item);
+      done += itemSize;
+      s->offset += itemSize;
     }
-    memcpy(ptr, item, itemSize);
-    vRingbufferReturnItem(s->ringBuffer, item);
-    s->offset += itemSize;
-    return itemSize / size;
+    return done / size;
   }
 
   return 0;
 }
 
+// Flash operations stall code running from flash on both cores: keep each
+// call short and let loop() and the BLE stack run between slices.
+// The first slice of a sector also erases it (sequential writes).
+static esp_err_t ota_write_sliced(esp_ota_handle_t handle, const void *data,
+                                  size_t len, OTAWriteStats *stats) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  for (size_t done = 0; done < len;) {
+    size_t slice = len - done;
+    if (slice > OTA_WRITE_SLICE_SIZE)
+      slice = OTA_WRITE_SLICE_SIZE;
+
+    uint32_t start = micros();
+    esp_err_t err = esp_ota_write(handle, p + done, slice);
+    uint32_t elapsed = micros() - start;
+    if (stats) {
+      stats->flashUs += elapsed;
+      if (elapsed > stats->maxSliceUs)
+        stats->maxSliceUs = elapsed;
+    }
+    if (err != ESP_OK)
+      return err;
+
+    done += slice;
+    vTaskDelay(1);
+  }
+  return ESP_OK;
+}
+
+// Sequential mode erases each sector on its first write. Without it
+// esp_ota_begin() erases the whole image area up front (seconds for a
+// large partition), so both update paths call this from their flash task.
+static esp_err_t ota_begin(const esp_partition_t *partition,
+                           uint32_t imageSize, esp_ota_handle_t *handle) {
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+  (void)imageSize;
+  return esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, handle);
+#else
+  return esp_ota_begin(partition, imageSize ? imageSize : OTA_SIZE_UNKNOWN,
+                       handle);
+#endif
+}
+
 static size_t ota_fwrite(const void *ptr, size_t size, size_t count,
                          FILE *stream) {
   OtaStream *s = reinterpret_cast<OtaStream *>(stream);
@@ -100,12 +138,15 @@ static size_t ota_fwrite(const void *ptr, size_t size, size_t count,
     return 0;
 
   size_t total = size * count;
-  esp_err_t err = esp_ota_write(s->otaHandle, ptr, total);
+  esp_err_t err = ota_write_sliced(s->otaHandle, ptr, total, nullptr);
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(err));
     return 0;
   }
 
+  if (s->verifier)
+    s->verifier->update(static_cast<const uint8_t *>(ptr), total);
+
   s->offset += total;
   return count;
 }
@@ -127,11 +168,7 @@ static int ota_fseek(FILE *stream, long offset, int origin) {
     break;
   }
 
-  // Invalidate cache on seek
-  if (s->isSource) {
-    s->cacheValid = false;
-  }
-
+  // Cache stays valid: pages are addressed by absolute offset
   return 0;
 }
 
@@ -149,13 +186,37 @@ ESP32OTAService::ESP32OTAService() {}
 ESP32OTAService::~ESP32OTAService() { abort(); }
 
 bool ESP32OTAService::begin() {
-  // Pre-allocate ring buffer for delta updates
-  ringBuffer_ = xRingbufferCreate(OTA_RING_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF);
+  // Pre-allocate ring buffer for delta updates. A bigger window in PSRAM
+  // lets the client keep more patch bytes in flight.
+  if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) >=
+      2 * OTA_RING_BUFFER_SIZE_PSRAM) {
+    ringStorage_ = (uint8_t *)heap_caps_malloc(OTA_RING_BUFFER_SIZE_PSRAM,
+                                               MALLOC_CAP_SPIRAM);
+  }
+  if (ringStorage_) {
+    ringSize_ = OTA_RING_BUFFER_SIZE_PSRAM;
+    ringBuffer_ = xRingbufferCreateStatic(ringSize_, RINGBUF_TYPE_BYTEBUF,
+                                          ringStorage_, &ringStruct_);
+  } else {
+    ringSize_ = OTA_RING_BUFFER_SIZE;
+    ringBuffer_ = xRingbufferCreate(ringSize_, RINGBUF_TYPE_BYTEBUF);
+  }
   if (!ringBuffer_) {
     ESP_LOGE(TAG, "Failed to create ring buffer");
     return false;
   }
 
+  // Full-image writer: queue depth 2 = both blocks in flight
+  writeQueue_ = xQueueCreate(2, sizeof(uint16_t) * 2);
+  freeBlocks_ = xSemaphoreCreateCounting(2, 2);
+  if (!writeQueue_ || !freeBlocks_ ||
+      xTaskCreatePinnedToCore(writerTask, "OTA_Write", 4096, this,
+                              OTA_TASK_PRIORITY, &writerTask_,
+                              OTA_TASK_CORE) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create OTA writer");
+    return false;
+  }
+
   runningPartition_ = esp_ota_get_running_partition();
   ESP_LOGI(TAG, "OTA service initialized. Running: %s",
            runningPartition_->label);
@@ -166,12 +227,25 @@ void ESP32OTAService::abort() {
   if (status_ == OTAStatus::IDLE)
     return;
 
-  // Stop delta task if running
+  // Stop delta task: ask it to bail out so it frees its buffers
   if (deltaTask_) {
-    vTaskDelete(deltaTask_);
+    deltaCancel_ = true;
+    uint32_t start = millis();
+    while (!deltaComplete_ && millis() - start < OTA_WRITE_TIMEOUT_MS)
+      vTaskDelay(pdMS_TO_TICKS(10));
+    if (!deltaComplete_)
+      vTaskDelete(deltaTask_);
     deltaTask_ = nullptr;
   }
 
+  // Let the writer finish before the handle goes away
+  if (!isDelta_) {
+    drainWrites();
+    releaseBlocks();
+    inflater_.end();
+    compressed_ = false;
+  }
+
   // End OTA session
   if (otaHandle_) {
     esp_ota_abort(otaHandle_);
@@ -193,6 +267,7 @@ void ESP32OTAService::abort() {
   receivedBytes_ = 0;
   calculatedCRC_ = 0;
   deltaComplete_ = false;
+  deltaCancel_ = false;
 
   ESP_LOGI(TAG, "OTA aborted");
 }
@@ -208,6 +283,85 @@ bool ESP32OTAService::startFirmwareUpdate(uint32_t expectedSize,
     return false;
   }
 
+  compressed_ = false;
+  if (!beginSignature(expectedSize) || !beginFullUpdate(expectedSize))
+    return false;
+
+  expectedSize_ = expectedSize;
+  expectedCRC_ = crc32;
+  status_ = OTAStatus::RECEIVING;
+
+  ESP_LOGI(TAG, "Started full update: %u bytes -> %s", expectedSize,
+           updatePartition_->label);
+  return true;
+}
+
+bool ESP32OTAService::startCompressedUpdate(uint32_t compressedSize,
+                                            uint32_t imageSize,
+                                            uint32_t crc32) {
+  if (status_ != OTAStatus::IDLE) {
+    ESP_LOGE(TAG, "Already in progress");
+    return false;
+  }
+
+  if (!beginSignature(compressedSize))
+    return false;
+
+  if (!inflater_.begin([this](const uint8_t *data, size_t len) {
+        return writeImage(data, len);
+      })) {
+    ESP_LOGE(TAG, "Failed to allocate inflater");
+    return false;
+  }
+
+  compressed_ = true;
+  if (!beginFullUpdate(imageSize)) {
+    inflater_.end();
+    compressed_ = false;
+    return false;
+  }
+
+  expectedSize_ = compressedSize;
+  expectedCRC_ = crc32;
+  imageSize_ = imageSize;
+  status_ = OTAStatus::RECEIVING;
+
+  ESP_LOGI(TAG, "Started compressed update: %u -> %u bytes -> %s",
+           compressedSize, imageSize, updatePartition_->label);
+  return true;
+}
+
+bool ESP32OTAService::beginSignature(uint32_t streamSize) {
+  signed_ = verifier_.hasKey();
+  if (!signed_) {
+    payloadSize_ = streamSize;
+    return true;
+  }
+
+  if (streamSize <= OTA_SIGNATURE_SIZE) {
+    ESP_LOGE(TAG, "Stream too short for a signature: %u", streamSize);
+    return false;
+  }
+
+  payloadSize_ = streamSize - OTA_SIGNATURE_SIZE;
+  memset(signature_, 0, sizeof(signature_));
+  verifier_.begin();
+  return true;
+}
+
+size_t ESP32OTAService::splitSignature(const uint8_t *data, size_t len) {
+  if (receivedBytes_ + len <= payloadSize_)
+    return len;
+
+  // Trailer: copy into signature_, return the image part only
+  size_t payload =
+      receivedBytes_ < payloadSize_ ? payloadSize_ - receivedBytes_ : 0;
+  memcpy(signature_ + (receivedBytes_ + payload - payloadSize_),
+         data + payload, len - payload);
+  return payload;
+}
+
+bool ESP32OTAService::beginFullUpdate(uint32_t imageSize) {
   updatePartition_ = esp_ota_get_next_update_partition(nullptr);
   if (!updatePartition_) {
     ESP_LOGE(TAG, "No update partition");
@@ -215,28 +369,39 @@ bool ESP32OTAService::startFirmwareUpdate(uint32_t expectedSize,
   }
 
   // Check size fits
-  if (expectedSize > updatePartition_->size) {
-    ESP_LOGE(TAG, "Firmware too large: %u > %u", expectedSize,
+  if (imageSize > updatePartition_->size) {
+    ESP_LOGE(TAG, "Firmware too large: %u > %u", imageSize,
              updatePartition_->size);
     return false;
   }
 
-  esp_err_t err =
-      esp_ota_begin(updatePartition_, OTA_SIZE_UNKNOWN, &otaHandle_);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Begin failed: %s", esp_err_to_name(err));
+  for (int i = 0; i < 2; i++) {
+    blocks_[i] = (uint8_t *)heap_caps_malloc(
+        OTA_WRITE_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (!blocks_[0] || !blocks_[1]) {
+    ESP_LOGE(TAG, "Failed to allocate write blocks");
+    releaseBlocks();
     return false;
   }
 
-  expectedSize_ = expectedSize;
-  expectedCRC_ = crc32;
   receivedBytes_ = 0;
   calculatedCRC_ = 0;
   isDelta_ = false;
-  status_ = OTAStatus::RECEIVING;
-
-  ESP_LOGI(TAG, "Started full update: %u bytes -> %s", expectedSize,
-           updatePartition_->label);
+  fillIdx_ = 0;
+  fillLen_ = 0;
+  fillOwned_ = false;
+  writeFailed_ = false;
+  inflateFailed_ = false;
+  writeStats_ = OTAWriteStats();
+  startMs_ = millis();
+
+  // esp_ota_begin() runs in the writer, ahead of the first block. It
+  // holds a block until done, so drainWrites() also waits for it.
+  xSemaphoreTake(freeBlocks_, portMAX_DELAY); // Both free: never waits
+  beginSize_ = imageSize;
+  uint16_t begin[2] = {OTA_BLOCK_BEGIN, 0};
+  xQueueSend(writeQueue_, begin, portMAX_DELAY);
   return true;
 }
 
@@ -253,23 +418,161 @@ bool ESP32OTAService::writeFirmwareChunk(const uint8_t *data, size_t len) {
     return false;
   }
 
-  // Write to flash
-  esp_err_t err = esp_ota_write(otaHandle_, data, len);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
-    status_ = OTAStatus::ERROR_FLASH;
+  if (writeFailed_) {
+    status_ = inflateFailed_ ? OTAStatus::ERROR_CRC : OTAStatus::ERROR_FLASH;
     notifyComplete(status_);
     return false;
   }
 
+  // Never blocks: the client was told the window (getWindow()), and the
+  // Controller keeps packets that don't fit in its inbox
+  const uint8_t *src = data;
+  size_t remaining = splitSignature(data, len);
+  if (remaining > getWindow()) {
+    ESP_LOGE(TAG, "Window overrun: %u bytes, %u free", remaining,
+             getWindow());
+    status_ = OTAStatus::ERROR_SPACE;
+    notifyComplete(status_);
+    return false;
+  }
+
+  while (remaining > 0) {
+    if (!fillOwned_) {
+      // Within the window a free block is always there
+      if (xSemaphoreTake(freeBlocks_, 0) != pdTRUE) {
+        ESP_LOGE(TAG, "No free block");
+        status_ = OTAStatus::ERROR_SPACE;
+        notifyComplete(status_);
+        return false;
+      }
+      fillOwned_ = true;
+      fillLen_ = 0;
+    }
+
+    size_t room = OTA_WRITE_BUFFER_SIZE - fillLen_;
+    size_t n = (remaining > room) ? room : remaining;
+    memcpy(blocks_[fillIdx_] + fillLen_, src, n);
+    fillLen_ += n;
+    src += n;
+    remaining -= n;
+
+    if (fillLen_ == OTA_WRITE_BUFFER_SIZE)
+      submitBlock();
+  }
+
   // Update progress
   receivedBytes_ += len;
-  calculatedCRC_ = esp_crc32_le(calculatedCRC_, data, len);
   notifyProgress();
 
   return true;
 }
 
+void ESP32OTAService::submitBlock() {
+  uint16_t block[2] = {fillIdx_, (uint16_t)fillLen_};
+  xQueueSend(writeQueue_, block, portMAX_DELAY); // Never full: depth 2
+  writeStats_.blocks++;
+  fillIdx_ ^= 1;
+  fillOwned_ = false;
+}
+
+bool ESP32OTAService::drainWrites() {
+  if (!freeBlocks_)
+    return true;
+
+  if (fillOwned_) {
+    xSemaphoreGive(freeBlocks_); // Unsubmitted block is free again
+    fillOwned_ = false;
+  }
+
+  // Both blocks free = writer idle
+  int taken = 0;
+  for (; taken < 2; taken++) {
+    if (xSemaphoreTake(freeBlocks_, pdMS_TO_TICKS(OTA_WRITE_TIMEOUT_MS)) !=
+        pdTRUE)
+      break;
+  }
+  for (int i = 0; i < taken; i++)
+    xSemaphoreGive(freeBlocks_);
+
+  return taken == 2;
+}
+
+void ESP32OTAService::releaseBlocks() {
+  for (int i = 0; i < 2; i++) {
+    if (blocks_[i]) {
+      heap_caps_free(blocks_[i]);
+      blocks_[i] = nullptr;
+    }
+  }
+}
+
+void ESP32OTAService::writerTask(void *params) {
+  ESP32OTAService *self = static_cast<ESP32OTAService *>(params);
+  uint16_t block[2];
+
+  for (;;) {
+    if (xQueueReceive(self->writeQueue_, block, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    if (block[0] == OTA_BLOCK_BEGIN) {
+      uint32_t start = micros();
+      esp_err_t err = ota_begin(self->updatePartition_, self->beginSize_,
+                                &self->otaHandle_);
+      self->writeStats_.flashUs += micros() - start;
+      if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Begin failed: %s", esp_err_to_name(err));
+        self->otaHandle_ = 0;
+        self->writeFailed_ = true;
+      }
+      xSemaphoreGive(self->freeBlocks_);
+      continue;
+    }
+
+    const uint8_t *data = self->blocks_[block[0]];
+    size_t len = block[1];
+
+    if (self->writeFailed_) {
+      // Update already failed, just recycle the block
+    } else if (self->compressed_) {
+      // Inflate into the partition; output runs are >= one sector
+      uint32_t start = micros();
+      self->sinkUs_ = 0;
+      InflateResult result = self->inflater_.write(data, len);
+      self->writeStats_.inflateUs += micros() - start - self->sinkUs_;
+
+      if (result == InflateResult::ERROR) {
+        ESP_LOGE(TAG, "Corrupt compressed image at %u",
+                 self->inflater_.totalIn());
+        self->inflateFailed_ = true;
+        self->writeFailed_ = true;
+      }
+    } else {
+      // Sector-aligned: erase (sequential mode) + program of one sector
+      self->writeImage(data, len);
+    }
+
+    xSemaphoreGive(self->freeBlocks_);
+  }
+}
+
+bool ESP32OTAService::writeImage(const uint8_t *data, size_t len) {
+  uint32_t start = micros();
+  esp_err_t err = ota_write_sliced(otaHandle_, data, len, &writeStats_);
+  sinkUs_ += micros() - start;
+
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+    writeFailed_ = true;
+    return false;
+  }
+
+  calculatedCRC_ = esp_crc32_le(calculatedCRC_, data, len);
+  if (signed_)
+    verifier_.update(data, len);
+  writeStats_.imageBytes += len;
+  return true;
+}
+
 bool ESP32OTAService::finalizeFirmwareUpdate() {
   if (status_ != OTAStatus::RECEIVING || isDelta_) {
     return false;
@@ -277,14 +580,53 @@ bool ESP32OTAService::finalizeFirmwareUpdate() {
 
   status_ = OTAStatus::VALIDATING;
 
-  // Verify size
-  if (receivedBytes_ != expectedSize_) {
+  // Flush tail block, wait until the writer is idle
+  if (fillOwned_ && fillLen_ > 0)
+    submitBlock();
+  bool drained = drainWrites();
+  releaseBlocks();
+
+  bool inflated = !compressed_ || inflater_.isDone();
+  inflater_.end();
+
+  writeStats_.durationMs = millis() - startMs_;
+  writeStats_.throughputBps =
+      writeStats_.durationMs
+          ? (uint32_t)((uint64_t)receivedBytes_ * 1000 / writeStats_.durationMs)
+          : 0;
+  ESP_LOGI(TAG, "Wrote %u bytes in %u ms (%u B/s), flash %u ms",
+           receivedBytes_, writeStats_.durationMs, writeStats_.throughputBps,
+           writeStats_.flashUs / 1000);
+  if (compressed_) {
+    ESP_LOGI(TAG, "Inflated to %u bytes, inflate %u ms",
+             writeStats_.imageBytes, writeStats_.inflateUs / 1000);
+  }
+
+  if (!drained || writeFailed_) {
+    status_ = !drained        ? OTAStatus::ERROR_TIMEOUT
+              : inflateFailed_ ? OTAStatus::ERROR_CRC
+                               : OTAStatus::ERROR_FLASH;
+    notifyComplete(status_);
+    return false;
+  }
+
+  // Verify size (stream as sent, then image as written)
+  if (receivedBytes_ != expectedSize_ ||
+      (compressed_ && writeStats_.imageBytes != imageSize_)) {
     ESP_LOGE(TAG, "Size mismatch: %u != %u", receivedBytes_, expectedSize_);
     status_ = OTAStatus::ERROR_SPACE;
     notifyComplete(status_);
     return false;
   }
 
+  // Truncated stream: no zlib trailer, Adler-32 never checked
+  if (!inflated) {
+    ESP_LOGE(TAG, "Compressed image incomplete");
+    status_ = OTAStatus::ERROR_CRC;
+    notifyComplete(status_);
+    return false;
+  }
+
   // Verify CRC
   if (calculatedCRC_ != expectedCRC_) {
     ESP_LOGE(TAG, "CRC mismatch: 0x%08X != 0x%08X", calculatedCRC_,
@@ -294,6 +636,13 @@ bool ESP32OTAService::finalizeFirmwareUpdate() {
     return false;
   }
 
+  // Hash ran alongside the writes: only the ECDSA verify is left
+  if (signed_ && !verifier_.verify(signature_)) {
+    status_ = OTAStatus::ERROR_SIGNATURE;
+    notifyComplete(status_);
+    return false;
+  }
+
   // Commit
   esp_err_t err = esp_ota_end(otaHandle_);
   otaHandle_ = 0;
@@ -329,22 +678,30 @@ bool ESP32OTAService::startDeltaUpdate(uint32_t patchSize, uint32_t sourceCRC) {
     return false;
   }
 
+  if (!beginSignature(patchSize))
+    return false;
+
   updatePartition_ = esp_ota_get_next_update_partition(nullptr);
   if (!updatePartition_) {
     ESP_LOGE(TAG, "No update partition");
     return false;
   }
 
-  // Verify source CRC matches running partition
-  // (Skip for now - would need to read entire partition)
-
-  esp_err_t err =
-      esp_ota_begin(updatePartition_, OTA_SIZE_UNKNOWN, &otaHandle_);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Begin failed: %s", esp_err_to_name(err));
-    return false;
+  // Verify source CRC against the running image in the background;
+  // loop() aborts early on mismatch, processDelta() waits before boot
+  if (sourceCrcState_ == CRC_IDLE || sourceCrcState_ == CRC_FAILED) {
+    sourceCrcState_ = CRC_RUNNING;
+    if (xTaskCreatePinnedToCore(sourceCrcTask, "OTA_SrcCRC", 3072, this,
+                                OTA_TASK_PRIORITY, nullptr,
+                                OTA_TASK_CORE) != pdPASS) {
+      ESP_LOGE(TAG, "Failed to create source CRC task");
+      sourceCrcState_ = CRC_IDLE;
+      return false;
+    }
   }
 
+  // esp_ota_begin() runs in the delta task, never in the caller's loop()
+  otaHandle_ = 0;
   expectedSize_ = patchSize;
   sourceCRC_ = sourceCRC;
   receivedBytes_ = 0;
@@ -360,7 +717,21 @@ bool ESP32OTAService::startDeltaUpdate(uint32_t patchSize, uint32_t sourceCRC) {
     vRingbufferReturnItem(ringBuffer_, item);
   }
 
-  ESP_LOGI(TAG, "Started delta update: %u bytes patch", patchSize);
+  // janpatch consumes the patch as it arrives: the ring only has to hold
+  // what the client keeps in flight, not the whole patch
+  deltaCancel_ = false;
+  BaseType_t result =
+      xTaskCreatePinnedToCore(deltaWorkerTask, "OTA_Delta", 8192, this,
+                              OTA_TASK_PRIORITY, &deltaTask_, OTA_TASK_CORE);
+  if (result != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create delta task");
+    status_ = OTAStatus::IDLE;
+    isDelta_ = false;
+    return false;
+  }
+
+  ESP_LOGI(TAG, "Started delta update: %u bytes patch, %u byte window",
+           patchSize, ringSize_);
   return true;
 }
 
@@ -369,9 +740,20 @@ bool ESP32OTAService::writeDeltaChunk(const uint8_t *data, size_t len) {
     return false;
   }
 
-  // Push to ring buffer (with timeout)
-  if (xRingbufferSend(ringBuffer_, data, len, pdMS_TO_TICKS(1000)) != pdTRUE) {
-    ESP_LOGE(TAG, "Ring buffer full!");
+  if (receivedBytes_ + len > expectedSize_) {
+    ESP_LOGE(TAG, "Overflow: %u + %u > %u", receivedBytes_, len, expectedSize_);
+    status_ = OTAStatus::ERROR_SPACE;
+    notifyComplete(status_);
+    return false;
+  }
+
+  // Never blocks: the client was told the window (getWindow())
+  size_t payload = splitSignature(data, len);
+  if (payload > 0 && xRingbufferSend(ringBuffer_, data, payload, 0) != pdTRUE) {
+    ESP_LOGE(TAG, "Window overrun: %u bytes, %u free", len,
+             xRingbufferGetCurFreeSize(ringBuffer_));
+    status_ = OTAStatus::ERROR_SPACE;
+    notifyComplete(status_);
     return false;
   }
 
@@ -385,20 +767,90 @@ bool ESP32OTAService::finalizeDeltaUpdate() {
     return false;
   }
 
+  if (receivedBytes_ != expectedSize_) {
+    ESP_LOGE(TAG, "Size mismatch: %u != %u", receivedBytes_, expectedSize_);
+    status_ = OTAStatus::ERROR_SPACE;
+    notifyComplete(status_);
+    return false;
+  }
+
+  // Task is already patching; loop() reports when it finishes
   status_ = OTAStatus::APPLYING;
-  ESP_LOGI(TAG, "Starting delta patch task...");
+  ESP_LOGI(TAG, "Patch received, finishing janpatch...");
+  return true;
+}
 
-  // Start background task
-  BaseType_t result = xTaskCreate(deltaWorkerTask, "OTA_Delta", 8192, this,
-                                  tskIDLE_PRIORITY + 2, &deltaTask_);
+size_t ESP32OTAService::getWindow() const {
+  if (status_ != OTAStatus::RECEIVING)
+    return 0;
 
-  if (result != pdPASS) {
-    ESP_LOGE(TAG, "Failed to create delta task");
-    status_ = OTAStatus::ERROR_FLASH;
-    notifyComplete(status_);
-    return false;
+  if (isDelta_)
+    return xRingbufferGetCurFreeSize(ringBuffer_);
+
+  size_t window = uxSemaphoreGetCount(freeBlocks_) * OTA_WRITE_BUFFER_SIZE;
+  if (fillOwned_)
+    window += OTA_WRITE_BUFFER_SIZE - fillLen_;
+  return window;
+}
+
+void ESP32OTAService::sourceCrcTask(void *params) {
+  ESP32OTAService *self = static_cast<ESP32OTAService *>(params);
+  self->computeRunningCrc();
+  vTaskDelete(nullptr);
+}
+
+void ESP32OTAService::computeRunningCrc() {
+  // CRC covers the image as built, not the 0xFF padding of the partition
+  esp_partition_pos_t pos = {runningPartition_->address,
+                             runningPartition_->size};
+  esp_image_metadata_t meta = {};
+  if (esp_image_get_metadata(&pos, &meta) != ESP_OK || meta.image_len == 0) {
+    ESP_LOGE(TAG, "Running image metadata unreadable");
+    sourceCrcState_ = CRC_FAILED;
+    return;
   }
 
+  uint8_t *buffer =
+      (uint8_t *)heap_caps_malloc(OTA_SOURCE_PAGE_SIZE, MALLOC_CAP_8BIT);
+  if (!buffer) {
+    sourceCrcState_ = CRC_FAILED;
+    return;
+  }
+
+  uint32_t crc = 0;
+  uint32_t start = millis();
+  for (uint32_t offset = 0; offset < meta.image_len;
+       offset += OTA_SOURCE_PAGE_SIZE) {
+    uint32_t len = meta.image_len - offset;
+    if (len > OTA_SOURCE_PAGE_SIZE)
+      len = OTA_SOURCE_PAGE_SIZE;
+
+    if (esp_partition_read(runningPartition_, offset, buffer, len) != ESP_OK) {
+      heap_caps_free(buffer);
+      sourceCrcState_ = CRC_FAILED;
+      return;
+    }
+    crc = esp_crc32_le(crc, buffer, len);
+    taskYIELD(); // Share the core with the other flash tasks
+  }
+  heap_caps_free(buffer);
+
+  runningCRC_ = crc;
+  runningImageLen_ = meta.image_len;
+  sourceCrcState_ = CRC_DONE;
+  ESP_LOGI(TAG, "Running image: %u bytes, CRC 0x%08X (%u ms)",
+           runningImageLen_, runningCRC_, millis() - start);
+}
+
+bool ESP32OTAService::waitSourceCrc() {
+  while (sourceCrcState_ == CRC_RUNNING)
+    vTaskDelay(pdMS_TO_TICKS(10));
+
+  if (sourceCrcState_ != CRC_DONE || runningCRC_ != sourceCRC_) {
+    ESP_LOGE(TAG, "Source mismatch: running 0x%08X, patch expects 0x%08X",
+             runningCRC_, sourceCRC_);
+    return false;
+  }
   return true;
 }
 
@@ -411,10 +863,30 @@ void ESP32OTAService::deltaWorkerTask(void *params) {
 void ESP32OTAService::processDelta() {
   ESP_LOGI(TAG, "Delta worker started");
 
-  // Allocate page cache for source reads
-  uint8_t *pageCache =
-      (uint8_t *)heap_caps_malloc(JANPATCH_PAGE_SIZE, MALLOC_CAP_8BIT);
-  if (!pageCache) {
+  // Patched image size is unknown until janpatch finishes
+  esp_ota_handle_t handle = 0;
+  esp_err_t beginErr = ota_begin(updatePartition_, 0, &handle);
+  if (beginErr != ESP_OK) {
+    ESP_LOGE(TAG, "Begin failed: %s", esp_err_to_name(beginErr));
+    deltaResult_ = OTAStatus::ERROR_FLASH;
+    deltaComplete_ = true;
+    return;
+  }
+  otaHandle_ = handle; // abort() ends it after a cancel
+
+  // Allocate LRU cache for source reads
+  const esp_partition_t *source = runningPartition_;
+  PageCache cache(OTA_SOURCE_CACHE_PAGES, OTA_SOURCE_PAGE_SIZE);
+  bool cacheOk = cache.begin(
+      [source](uint32_t address, uint8_t *out, size_t len) {
+        esp_err_t err = esp_partition_read(source, address, out, len);
+        if (err != ESP_OK) {
+          ESP_LOGE(TAG, "Source read failed at 0x%x", address);
+        }
+        return err == ESP_OK;
+      },
+      source->size);
+  if (!cacheOk) {
     ESP_LOGE(TAG, "Failed to allocate page cache");
     deltaResult_ = OTAStatus::ERROR_FLASH;
     deltaComplete_ = true;
@@ -427,13 +899,14 @@ void ESP32OTAService::processDelta() {
   sourceStream.partition = runningPartition_;
   sourceStream.offset = 0;
   sourceStream.isSource = true;
-  sourceStream.pageCache = pageCache;
-  sourceStream.cacheValid = false;
+  sourceStream.cache = &cache;
 
   OtaStream patchStream = {};
   patchStream.service = this;
   patchStream.ringBuffer = ringBuffer_;
   patchStream.offset = 0;
+  patchStream.limit = payloadSize_;
+  patchStream.cancel = &deltaCancel_;
   patchStream.isPatch = true;
 
   OtaStream targetStream = {};
@@ -442,6 +915,7 @@ void ESP32OTAService::processDelta() {
   targetStream.otaHandle = otaHandle_;
   targetStream.offset = 0;
   targetStream.isTarget = true;
+  targetStream.verifier = signed_ ? &verifier_ : nullptr;
 
   // Allocate janpatch buffers
   uint8_t *buffer1 =
@@ -451,7 +925,6 @@ void ESP32OTAService::processDelta() {
 
   if (!buffer1 || !buffer2) {
     ESP_LOGE(TAG, "Failed to allocate janpatch buffers");
-    free(pageCache);
     if (buffer1)
       free(buffer1);
     if (buffer2)
@@ -482,10 +955,21 @@ void ESP32OTAService::processDelta() {
                         (FILE *)&targetStream);
 
   // Cleanup
-  free(pageCache);
+  sourceCacheStats_ = cache.getStats();
+  ESP_LOGI(TAG, "Source cache: %u hits, %u misses, %u evictions",
+           sourceCacheStats_.hits, sourceCacheStats_.misses,
+           sourceCacheStats_.evictions);
+  cache.end();
   free(buffer1);
   free(buffer2);
 
+  if (deltaCancel_) {
+    // abort() owns the handle from here
+    deltaResult_ = OTAStatus::IDLE;
+    deltaComplete_ = true;
+    return;
+  }
+
   if (result != 0) {
     ESP_LOGE(TAG, "Janpatch failed: %d", result);
     esp_ota_abort(otaHandle_);
@@ -495,6 +979,24 @@ void ESP32OTAService::processDelta() {
     return;
   }
 
+  // Never boot a target built from a different source
+  if (!waitSourceCrc()) {
+    esp_ota_abort(otaHandle_);
+    otaHandle_ = 0;
+    deltaResult_ = OTAStatus::ERROR_SOURCE;
+    deltaComplete_ = true;
+    return;
+  }
+
+  // Image is complete and hashed: check it before it can boot
+  if (signed_ && !verifier_.verify(signature_)) {
+    esp_ota_abort(otaHandle_);
+    otaHandle_ = 0;
+    deltaResult_ = OTAStatus::ERROR_SIGNATURE;
+    deltaComplete_ = true;
+    return;
+  }
+
   // Finalize OTA
   esp_err_t err = esp_ota_end(otaHandle_);
   otaHandle_ = 0;
@@ -519,8 +1021,18 @@ void ESP32OTAService::processDelta() {
 }
 
 void ESP32OTAService::loop() {
+  // Early abort: mismatch known while the patch is still streaming
+  if (isDelta_ && status_ == OTAStatus::RECEIVING &&
+      sourceCrcState_ != CRC_RUNNING && !waitSourceCrc()) {
+    abort();
+    notifyComplete(OTAStatus::ERROR_SOURCE);
+    return;
+  }
+
   // Check if delta task completed
-  if (isDelta_ && deltaComplete_) {
+  // Finished early (failure while patch still streaming), or after END
+  if (isDelta_ && deltaComplete_ &&
+      (status_ == OTAStatus::APPLYING || deltaResult_ != OTAStatus::SUCCESS)) {
     deltaComplete_ = false;
     deltaTask_ = nullptr;
     status_ = deltaResult_;
@@ -6,20 +6,76 @@
  * Implements OTA interface for full and delta firmware updates.
  * Delta updates use janpatch with ring buffer + background task.
  *
- * Full:  OTA:BEGIN → writeFirmwareChunk() → finalize → reboot
- * Delta: OTA:DELTA → writeDeltaChunk() → finalize → janpatch → reboot
+ * Full:  OTA:BEGIN → writeFirmwareChunk() → 4 KB blocks → writer task
+ *        → finalize → reboot (OTA:ZBEGIN: zlib blocks, the writer task
+ *        inflates them before writing)
+ * Delta: OTA:DELTA → janpatch task starts → writeDeltaChunk() feeds it
+ *        through the ring (never blocks) → finalize → reboot
+ *        (running image CRC checked in a background task meanwhile)
+ *
+ * With a signing key set, every stream ends with a 64-byte ECDSA P-256
+ * signature of the final image; it is verified before set_boot.
  */
 #pragma once
 #include "../interfaces/OTA.h"
+#include "InflateStream.h"
+#include "PageCache.h"
+#include "SignatureVerifier.h"
 #include <esp_ota_ops.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 
 namespace W4RP {
 
+/// Delta patch ring; PSRAM size used when enough PSRAM is free
+#ifndef OTA_RING_BUFFER_SIZE
 #define OTA_RING_BUFFER_SIZE 8192
-#define OTA_WRITE_BUFFER_SIZE 4096
+#endif
+#ifndef OTA_RING_BUFFER_SIZE_PSRAM
+#define OTA_RING_BUFFER_SIZE_PSRAM 65536
+#endif
+#define OTA_WRITE_BUFFER_SIZE 4096 // One flash sector per block
+#define OTA_WRITE_TIMEOUT_MS 2000  // Max wait for the writer at finalize
+#define OTA_BLOCK_BEGIN 0xFFFF     // Writer queue entry: esp_ota_begin()
+
+/// Delta source cache: pages x page size (page = flash sector)
+#ifndef OTA_SOURCE_CACHE_PAGES
+#define OTA_SOURCE_CACHE_PAGES 4
+#endif
+#ifndef OTA_SOURCE_PAGE_SIZE
+#define OTA_SOURCE_PAGE_SIZE 4096
+#endif
+
+/// Flash tasks (writer, janpatch, source CRC): loop() priority, pinned
+/// to the protocol core so the Arduino loop keeps its core for rules
+#ifndef OTA_TASK_PRIORITY
+#define OTA_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#endif
+#ifndef OTA_TASK_CORE
+#define OTA_TASK_CORE 0
+#endif
+
+/// Max bytes per esp_ota_write(); flash tasks sleep a tick between slices
+#ifndef OTA_WRITE_SLICE_SIZE
+#define OTA_WRITE_SLICE_SIZE 1024
+#endif
+
+/**
+ * @struct OTAWriteStats
+ * @brief Full-image write pipeline counters
+ */
+struct OTAWriteStats {
+  uint32_t blocks = 0;        ///< Blocks handed to the writer task
+  uint32_t flashUs = 0;       ///< Time spent in esp_ota_write (writer task)
+  uint32_t maxSliceUs = 0;    ///< Longest single esp_ota_write slice
+  uint32_t inflateUs = 0;     ///< Time spent decompressing (compressed only)
+  uint32_t imageBytes = 0;    ///< Bytes written to flash
+  uint32_t durationMs = 0;    ///< startFirmwareUpdate → finalize
+  uint32_t throughputBps = 0; ///< Image bytes / duration
+};
 
 /**
  * @class ESP32OTAService
@@ -31,7 +87,7 @@ public:
   ~ESP32OTAService();
 
   /**
-   * @brief Create ring buffer, get running partition
+   * @brief Create ring buffer (PSRAM if available), writer task
    * @return true on success
    */
   bool begin() override;
@@ -43,6 +99,8 @@ public:
 
   /**
    * @brief Begin full firmware update
+   * Queues esp_ota_begin() to the writer task; partition erase never runs
+   * in the caller.
    * @param expectedSize Firmware size
    * @param crc32 Expected CRC32
    * @return true on success
@@ -50,7 +108,22 @@ public:
   bool startFirmwareUpdate(uint32_t expectedSize, uint32_t crc32) override;
 
   /**
-   * @brief Write chunk to OTA partition
+   * @brief Begin full update from a zlib stream
+   * Chunks go through writeFirmwareChunk(); the writer task inflates each
+   * block straight into the partition (~43 KB while active).
+   * @param compressedSize Stream size (what the client sends)
+   * @param imageSize Decompressed image size
+   * @param crc32 CRC32 of the decompressed image
+   * @return true on success
+   */
+  bool startCompressedUpdate(uint32_t compressedSize, uint32_t imageSize,
+                             uint32_t crc32) override;
+
+  /**
+   * @brief Copy chunk into the current 4 KB block without blocking
+   * Full blocks go to the writer task (erase + write + CRC) while the
+   * other block fills. Callers must stay within getWindow(); an overrun
+   * fails the update with ERROR_SPACE.
    * @param data Chunk data
    * @param len Chunk length
    * @return true on success
@@ -58,21 +131,26 @@ public:
   bool writeFirmwareChunk(const uint8_t *data, size_t len) override;
 
   /**
-   * @brief Validate CRC, set boot partition
+   * @brief Flush last block, wait for writer, validate CRC, set boot
    * @return true on success
    */
   bool finalizeFirmwareUpdate() override;
 
   /**
-   * @brief Begin delta update
+   * @brief Begin delta update, start janpatch task
+   * The task calls esp_ota_begin() (and any erase) before patching.
+   * Patch bytes are consumed while they stream in. Starts the background CRC of the running image (once per boot);
+   * loop() aborts with ERROR_SOURCE as soon as it is known to mismatch.
    * @param patchSize Patch size
-   * @param sourceCRC Current firmware CRC32
+   * @param sourceCRC CRC32 of the running image the patch was built from
    * @return true on success
    */
   bool startDeltaUpdate(uint32_t patchSize, uint32_t sourceCRC) override;
 
   /**
-   * @brief Push chunk to ring buffer
+   * @brief Push chunk to ring buffer without blocking
+   * Callers must stay within getWindow(); an overrun fails the update
+   * with ERROR_SPACE instead of dropping bytes.
    * @param data Chunk data
    * @param len Chunk length
    * @return true on success
@@ -80,7 +158,7 @@ public:
   bool writeDeltaChunk(const uint8_t *data, size_t len) override;
 
   /**
-   * @brief Start background janpatch task
+   * @brief Check all patch bytes arrived, wait for janpatch (APPLYING)
    * @return true on success
    */
   bool finalizeDeltaUpdate() override;
@@ -116,10 +194,40 @@ public:
   }
 
   /**
-   * @brief Check if delta task completed
+   * @brief Check source CRC result and delta task completion
    */
   void loop() override;
 
+  /**
+   * @brief Free space for the next chunks
+   * Delta: free ring bytes. Full: free 4 KB block space.
+   * @return 0 when not receiving
+   */
+  size_t getWindow() const override;
+
+  /**
+   * @brief Require signed images
+   * Streams must then end with OTA_SIGNATURE_SIZE signature bytes
+   * (counted in the announced size). Set before starting an update.
+   * @param publicKey P-256 key, uncompressed SEC1 (65 bytes)
+   * @param len Key length
+   * @return false if the key is invalid (signatures stay off)
+   */
+  bool setSigningKey(const uint8_t *publicKey, size_t len) {
+    return verifier_.setPublicKey(publicKey, len);
+  }
+
+  /// @brief Ring capacity chosen in begin()
+  size_t getRingSize() const { return ringSize_; }
+
+  /// @brief Counters of the last full-image update
+  const OTAWriteStats &getWriteStats() const { return writeStats_; }
+
+  /// @brief Source cache counters of the last delta update
+  const PageCacheStats &getSourceCacheStats() const {
+    return sourceCacheStats_;
+  }
+
 private:
   OTAStatus status_ = OTAStatus::IDLE;
 
@@ -133,18 +241,66 @@ private:
   uint32_t calculatedCRC_ = 0;
 
   RingbufHandle_t ringBuffer_ = nullptr;
+  StaticRingbuffer_t ringStruct_;
+  uint8_t *ringStorage_ = nullptr;
+  size_t ringSize_ = 0;
   TaskHandle_t deltaTask_ = nullptr;
+  volatile bool deltaCancel_ = false;
   bool isDelta_ = false;
   uint32_t sourceCRC_ = 0;
   volatile bool deltaComplete_ = false;
   volatile OTAStatus deltaResult_ = OTAStatus::IDLE;
 
+  // Running image CRC, computed once per boot in a low-priority task
+  enum SourceCrcState : uint8_t { CRC_IDLE, CRC_RUNNING, CRC_DONE, CRC_FAILED };
+  volatile SourceCrcState sourceCrcState_ = CRC_IDLE;
+  uint32_t runningCRC_ = 0;
+  uint32_t runningImageLen_ = 0;
+
+  // Full-image write pipeline: two blocks, writer task, free-block count
+  uint8_t *blocks_[2] = {nullptr, nullptr};
+  uint8_t fillIdx_ = 0;
+  size_t fillLen_ = 0;
+  bool fillOwned_ = false;
+  QueueHandle_t writeQueue_ = nullptr;
+  SemaphoreHandle_t freeBlocks_ = nullptr;
+  TaskHandle_t writerTask_ = nullptr;
+  uint32_t beginSize_ = 0; ///< Image size for the writer's esp_ota_begin()
+  volatile bool writeFailed_ = false;
+  uint32_t startMs_ = 0;
+  OTAWriteStats writeStats_;
+
+  // Compressed full image: inflated in the writer task
+  InflateStream inflater_;
+  bool compressed_ = false;
+  uint32_t imageSize_ = 0;
+  volatile bool inflateFailed_ = false;
+  uint32_t sinkUs_ = 0; ///< Writer time in writeImage() (excl. from inflate)
+
+  // Signature: hashed as the image is written, trailer split off the stream
+  SignatureVerifier verifier_;
+  bool signed_ = false;
+  uint32_t payloadSize_ = 0; ///< Stream bytes before the signature
+  uint8_t signature_[OTA_SIGNATURE_SIZE];
+  PageCacheStats sourceCacheStats_;
+
   OTAProgressCallback progressCb_;
   OTACompleteCallback completeCb_;
 
   void notifyProgress();
   void notifyComplete(OTAStatus status);
   static void deltaWorkerTask(void *params);
+  static void writerTask(void *params);
+  static void sourceCrcTask(void *params);
+  void computeRunningCrc();
+  bool waitSourceCrc();
+  bool beginFullUpdate(uint32_t imageSize);
+  bool beginSignature(uint32_t streamSize);
+  size_t splitSignature(const uint8_t *data, size_t len);
+  bool writeImage(const uint8_t *data, size_t len);
+  void submitBlock();
+  bool drainWrites();
+  void releaseBlocks();
   void processDelta();
 };
 
@@ -0,0 +1,101 @@
+/**
+ * @file InflateStream.cpp
+ * @brief Incremental zlib decompression implementation
+ */
+
+#include "InflateStream.h"
+#include <stdlib.h>
+
+#if defined(ESP_PLATFORM)
+#include <rom/miniz.h>
+#else
+#include "miniz.h" // tinfl from the miniz distribution
+#endif
+
+namespace W4RP {
+
+InflateStream::InflateStream(size_t flushSize) : flushSize_(flushSize) {}
+
+InflateStream::~InflateStream() { end(); }
+
+bool InflateStream::begin(InflateSinkFn sink) {
+  end();
+
+  inflator_ = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+  window_ = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+  if (!inflator_ || !window_) {
+    end();
+    return false;
+  }
+
+  tinfl_init(inflator_);
+  sink_ = sink;
+  windowOfs_ = 0;
+  flushOfs_ = 0;
+  totalIn_ = 0;
+  totalOut_ = 0;
+  done_ = false;
+  return true;
+}
+
+void InflateStream::end() {
+  free(inflator_);
+  free(window_);
+  inflator_ = nullptr;
+  window_ = nullptr;
+}
+
+bool InflateStream::flush() {
+  size_t len = windowOfs_ - flushOfs_;
+  if (len > 0 && !sink_(window_ + flushOfs_, len))
+    return false;
+
+  // Window wraps: tinfl only ever writes up to its end
+  windowOfs_ &= TINFL_LZ_DICT_SIZE - 1;
+  flushOfs_ = windowOfs_;
+  return true;
+}
+
+InflateResult InflateStream::write(const uint8_t *data, size_t len) {
+  if (!inflator_)
+    return InflateResult::ERROR;
+  if (done_)
+    return len ? InflateResult::ERROR : InflateResult::DONE;
+
+  totalIn_ += len;
+
+  for (;;) {
+    size_t inBytes = len;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - windowOfs_;
+    tinfl_status status = tinfl_decompress(
+        inflator_, data, &inBytes, window_, window_ + windowOfs_, &outBytes,
+        TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32 |
+            TINFL_FLAG_HAS_MORE_INPUT);
+
+    data += inBytes;
+    len -= inBytes;
+    windowOfs_ += outBytes;
+    totalOut_ += outBytes;
+
+    if (status < TINFL_STATUS_DONE)
+      return InflateResult::ERROR;
+
+    if (status == TINFL_STATUS_DONE || windowOfs_ == TINFL_LZ_DICT_SIZE ||
+        windowOfs_ - flushOfs_ >= flushSize_) {
+      if (!flush())
+        return InflateResult::SINK_FAILED;
+    }
+
+    if (status == TINFL_STATUS_DONE) {
+      done_ = true;
+      return len ? InflateResult::ERROR : InflateResult::DONE;
+    }
+
+    // NEEDS_MORE_INPUT: wait for the next chunk.
+    // HAS_MORE_OUTPUT: window end reached and flushed, go again.
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT)
+      return len ? InflateResult::ERROR : InflateResult::NEED_INPUT;
+  }
+}
+
+} // namespace W4RP
@@ -0,0 +1,88 @@
+/**
+ * @file InflateStream.h
+ * @brief DRIVERS:InflateStream - Incremental zlib decompression
+ * @version 1.0.0
+ *
+ * Push-style inflater for compressed full-image OTA. Compressed bytes go
+ * in as they arrive; decompressed bytes come out through a sink callback
+ * in runs of at least flushSize bytes. Memory is fixed: the 32 KB deflate
+ * window plus the tinfl state (~11 KB), allocated in begin().
+ *
+ * Uses tinfl (miniz). On ESP32 it is in ROM, so it costs no flash.
+ * Portable - on the host, build it with miniz's tinfl to measure
+ * decompress throughput with the same code.
+ */
+#pragma once
+#include "../core/InplaceFunction.h"
+#include <stddef.h>
+#include <stdint.h>
+
+struct tinfl_decompressor_tag;
+
+namespace W4RP {
+
+/// Receives decompressed output; return false to stop
+using InflateSinkFn = InplaceFunction<bool(const uint8_t *data, size_t len)>;
+
+/**
+ * @enum InflateResult
+ * @brief Outcome of InflateStream::write()
+ */
+enum class InflateResult : uint8_t {
+  NEED_INPUT, ///< All input consumed, stream not finished
+  DONE,       ///< End of stream reached (Adler-32 verified)
+  ERROR,      ///< Corrupt stream or trailing data
+  SINK_FAILED ///< Sink returned false
+};
+
+/**
+ * @class InflateStream
+ * @brief zlib stream → sink, fixed memory
+ */
+class InflateStream {
+public:
+  /// @param flushSize Minimum run handed to the sink (except the tail)
+  explicit InflateStream(size_t flushSize = 4096);
+  ~InflateStream();
+
+  InflateStream(const InflateStream &) = delete;
+  InflateStream &operator=(const InflateStream &) = delete;
+
+  /**
+   * @brief Allocate window and decompressor state
+   * @param sink Output consumer
+   * @return false if allocation failed
+   */
+  bool begin(InflateSinkFn sink);
+
+  /// @brief Release memory
+  void end();
+
+  /**
+   * @brief Decompress a chunk of the zlib stream
+   * @param data Compressed bytes
+   * @param len Length
+   * @return NEED_INPUT until the stream ends
+   */
+  InflateResult write(const uint8_t *data, size_t len);
+
+  bool isDone() const { return done_; }
+  uint32_t totalIn() const { return totalIn_; }
+  uint32_t totalOut() const { return totalOut_; }
+
+private:
+  size_t flushSize_;
+  InflateSinkFn sink_;
+  tinfl_decompressor_tag *inflator_ = nullptr;
+  uint8_t *window_ = nullptr;
+  size_t windowOfs_ = 0; ///< Next byte tinfl writes
+  size_t flushOfs_ = 0;  ///< First byte not yet handed to the sink
+  uint32_t totalIn_ = 0;
+  uint32_t totalOut_ = 0;
+  bool done_ = false;
+
+  /** @brief Hand [flushOfs_, windowOfs_) to the sink */
+  bool flush();
+};
+
+} // namespace W4RP
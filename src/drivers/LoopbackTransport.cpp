@@ -0,0 +1,67 @@
+/**
+ * @file LoopbackTransport.cpp
+ * @brief In-memory transport implementation
+ */
+
+#include "LoopbackTransport.h"
+
+namespace W4RP {
+
+LoopbackTransport::LoopbackTransport(size_t mtu, size_t creditsPerLoop)
+    : mtu_(mtu), creditsPerLoop_(creditsPerLoop), credits_(creditsPerLoop) {}
+
+bool LoopbackTransport::begin(const char *) {
+  setConnected(true);
+  return true;
+}
+
+void LoopbackTransport::send(const uint8_t *data, size_t len) {
+  if (!connected_)
+    return;
+
+  if (credits_ == 0) {
+    stats_.creditStalls++;
+  } else {
+    credits_--;
+  }
+
+  stats_.packets++;
+  stats_.bytes += len;
+
+  if (tap_) {
+    tap_(false, data, len);
+  }
+}
+
+void LoopbackTransport::sendStatus(const uint8_t *data, size_t len) {
+  if (!connected_)
+    return;
+
+  stats_.statusPackets++;
+
+  if (tap_) {
+    tap_(true, data, len);
+  }
+}
+
+void LoopbackTransport::loop() { credits_ = creditsPerLoop_; }
+
+void LoopbackTransport::inject(const uint8_t *data, size_t len) {
+  if (connected_ && rxCallback_) {
+    rxCallback_(data, len);
+  }
+}
+
+void LoopbackTransport::setConnected(bool connected) {
+  if (connected == connected_)
+    return;
+
+  connected_ = connected;
+  credits_ = creditsPerLoop_;
+
+  if (connCallback_) {
+    connCallback_(connected);
+  }
+}
+
+} // namespace W4RP
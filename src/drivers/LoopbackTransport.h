@@ -0,0 +1,128 @@
+/**
+ * @file LoopbackTransport.h
+ * @brief DRIVERS:LoopbackTransport - In-memory transport
+ * @version 1.0.0
+ *
+ * Implements Communication interface without a radio. Packets sent by the
+ * Controller are counted and handed to an optional tap; the test harness
+ * injects client packets with inject(). Credits and MTU are configurable
+ * so bulk transfer time and loop stall can be measured off-target.
+ */
+#pragma once
+#include "../interfaces/Communication.h"
+
+namespace W4RP {
+
+using LoopbackTapCallback =
+    InplaceFunction<void(bool status, const uint8_t *data, size_t len)>;
+
+/**
+ * @struct LoopbackStats
+ * @brief Traffic seen by the loopback
+ */
+struct LoopbackStats {
+  uint32_t packets = 0;       ///< Notifications on the TX channel
+  uint32_t bytes = 0;         ///< Bytes on the TX channel
+  uint32_t statusPackets = 0; ///< Notifications on the status channel
+  uint32_t creditStalls = 0;  ///< send() calls made without a credit
+};
+
+/**
+ * @class LoopbackTransport
+ * @brief In-memory transport for host benchmarks and tests
+ */
+class LoopbackTransport : public Communication {
+public:
+  /**
+   * @brief Construct loopback
+   * @param mtu Chunk size reported by getMTU()
+   * @param creditsPerLoop Credits granted on every loop() call
+   */
+  explicit LoopbackTransport(size_t mtu = 128, size_t creditsPerLoop = 4);
+
+  /**
+   * @brief Mark as connected
+   * @param deviceName Ignored
+   * @return true
+   */
+  bool begin(const char *deviceName) override;
+
+  bool isConnected() const override { return connected_; }
+
+  /**
+   * @brief Count packet, consume one credit, forward to tap
+   * @param data Data buffer
+   * @param len Data length
+   */
+  void send(const uint8_t *data, size_t len) override;
+
+  /**
+   * @brief Count status packet, forward to tap
+   * @param data Data buffer
+   * @param len Data length
+   */
+  void sendStatus(const uint8_t *data, size_t len) override;
+
+  void onReceive(TransportRxCallback callback) override {
+    rxCallback_ = callback;
+  }
+
+  void onConnectionChange(TransportConnCallback callback) override {
+    connCallback_ = callback;
+  }
+
+  /**
+   * @brief Refill credits (simulates one connection event)
+   */
+  void loop() override;
+
+  size_t getMTU() const override { return mtu_; }
+
+  size_t txCredits() const override { return connected_ ? credits_ : 0; }
+
+  /**
+   * @brief Deliver a client packet to the receive callback
+   * @param data Packet data
+   * @param len Packet length
+   */
+  void inject(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Deliver a client text command
+   * @param str Null-terminated command
+   */
+  void inject(const char *str) {
+    inject((const uint8_t *)str, strlen(str));
+  }
+
+  /**
+   * @brief Simulate connect / disconnect
+   * @param connected New state
+   */
+  void setConnected(bool connected);
+
+  void setMTU(size_t mtu) { mtu_ = mtu; }
+  void setCreditsPerLoop(size_t credits) { creditsPerLoop_ = credits; }
+
+  /**
+   * @brief Observe outgoing packets
+   * @param tap Called with status=true for the status channel
+   */
+  void setTap(LoopbackTapCallback tap) { tap_ = tap; }
+
+  const LoopbackStats &getStats() const { return stats_; }
+  void resetStats() { stats_ = LoopbackStats(); }
+
+private:
+  size_t mtu_;
+  size_t creditsPerLoop_;
+  size_t credits_;
+  bool connected_ = false;
+
+  TransportRxCallback rxCallback_;
+  TransportConnCallback connCallback_;
+  LoopbackTapCallback tap_;
+  LoopbackStats stats_;
+};
+
+} // namespace W4RP
@@ -59,7 +59,7 @@ bool NVSStorage::writeBlob(const char *key, const uint8_t *data, size_t len) {
     return false;
   }
 
-  return commit();
+  return autoCommit_ ? commit() : true;
 }
 
 size_t NVSStorage::readBlob(const char *key, uint8_t *buffer, size_t maxLen) {
@@ -104,7 +104,7 @@ bool NVSStorage::writeString(const char *key, const String &value) {
     return false;
   }
 
-  return commit();
+  return autoCommit_ ? commit() : true;
 }
 
 String NVSStorage::readString(const char *key) {
@@ -147,7 +147,7 @@ bool NVSStorage::erase(const char *key) {
     return false;
   }
 
-  return commit();
+  return autoCommit_ ? commit() : true;
 }
 
 bool NVSStorage::commit() {
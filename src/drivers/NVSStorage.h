@@ -33,7 +33,7 @@ public:
   bool begin() override;
 
   /**
-   * @brief Write binary data + commit
+   * @brief Write binary data (+ commit if auto-commit)
    * @param key Storage key
    * @param data Data buffer
    * @param len Data length
@@ -51,7 +51,7 @@ public:
   size_t readBlob(const char *key, uint8_t *buffer, size_t maxLen) override;
 
   /**
-   * @brief Write string + commit
+   * @brief Write string (+ commit if auto-commit)
    * @param key Storage key
    * @param value String value
    * @return true on success
@@ -66,7 +66,7 @@ public:
   String readString(const char *key) override;
 
   /**
-   * @brief Delete key + commit
+   * @brief Delete key (+ commit if auto-commit)
    * @param key Storage key
    * @return true if deleted
    */
@@ -78,10 +78,17 @@ public:
    */
   bool commit() override;
 
+  /**
+   * @brief Enable/disable commit after every write
+   * @param enabled false when a write-behind layer batches commits
+   */
+  void setAutoCommit(bool enabled) override { autoCommit_ = enabled; }
+
 private:
   const char *namespace_;
   nvs_handle_t handle_ = 0;
   bool opened_ = false;
+  bool autoCommit_ = true;
 };
 
 } // namespace W4RP
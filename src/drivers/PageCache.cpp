@@ -0,0 +1,103 @@
+/**
+ * @file PageCache.cpp
+ * @brief LRU page cache implementation
+ */
+
+#include "PageCache.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace W4RP {
+
+PageCache::PageCache(size_t pages, size_t pageSize)
+    : pageSize_(pageSize), pages_(pages) {}
+
+PageCache::~PageCache() { end(); }
+
+bool PageCache::begin(PageReadFn reader, uint32_t limit) {
+  end();
+
+  data_ = (uint8_t *)malloc(pages_.size() * pageSize_);
+  if (!data_)
+    return false;
+
+  reader_ = reader;
+  limit_ = limit;
+  clock_ = 0;
+  stats_ = PageCacheStats();
+  return true;
+}
+
+void PageCache::end() {
+  free(data_);
+  data_ = nullptr;
+  for (Page &page : pages_)
+    page.valid = false;
+}
+
+const uint8_t *PageCache::lookup(uint32_t pageIndex) {
+  clock_++;
+
+  Page *victim = &pages_[0];
+  for (size_t i = 0; i < pages_.size(); i++) {
+    Page &page = pages_[i];
+    if (page.valid && page.index == pageIndex) {
+      page.lastUse = clock_;
+      stats_.hits++;
+      return data_ + i * pageSize_;
+    }
+    // Prefer an empty slot, then the least recently used
+    if (!victim->valid)
+      continue;
+    if (!page.valid || page.lastUse < victim->lastUse)
+      victim = &page;
+  }
+
+  stats_.misses++;
+  if (victim->valid)
+    stats_.evictions++;
+
+  size_t slot = victim - &pages_[0];
+  uint8_t *dst = data_ + slot * pageSize_;
+  uint32_t address = pageIndex * pageSize_;
+  size_t len = pageSize_;
+  if (address + len > limit_)
+    len = limit_ - address;
+
+  victim->valid = false;
+  if (!reader_(address, dst, len))
+    return nullptr;
+
+  victim->index = pageIndex;
+  victim->lastUse = clock_;
+  victim->valid = true;
+  return dst;
+}
+
+size_t PageCache::read(uint32_t offset, uint8_t *out, size_t len) {
+  if (!data_ || offset >= limit_)
+    return 0;
+
+  if (len > limit_ - offset)
+    len = limit_ - offset;
+
+  size_t done = 0;
+  while (done < len) {
+    uint32_t pos = offset + done;
+    const uint8_t *page = lookup(pos / pageSize_);
+    if (!page)
+      break;
+
+    size_t pageOffset = pos % pageSize_;
+    size_t n = pageSize_ - pageOffset;
+    if (n > len - done)
+      n = len - done;
+
+    memcpy(out + done, page + pageOffset, n);
+    done += n;
+  }
+
+  return done;
+}
+
+} // namespace W4RP
@@ -0,0 +1,93 @@
+/**
+ * @file PageCache.h
+ * @brief DRIVERS:PageCache - LRU cache of flash pages
+ * @version 1.0.0
+ *
+ * Read-through cache for a read-only region (the running partition during
+ * delta OTA). Holds N pages, evicts the least recently used one, and is
+ * never invalidated by seeks: janpatch jumps around the source image and
+ * usually lands on a page it read moments ago.
+ *
+ * Portable - the backing read is a callback, so the same cache runs
+ * against a file on the host.
+ */
+#pragma once
+#include "../core/InplaceFunction.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace W4RP {
+
+/// Read len bytes at address into out
+using PageReadFn =
+    InplaceFunction<bool(uint32_t address, uint8_t *out, size_t len)>;
+
+/**
+ * @struct PageCacheStats
+ * @brief Cache effectiveness counters
+ */
+struct PageCacheStats {
+  uint32_t hits = 0;      ///< Page lookups served from RAM
+  uint32_t misses = 0;    ///< Page lookups that read the backing store
+  uint32_t evictions = 0; ///< Misses that replaced a valid page
+};
+
+/**
+ * @class PageCache
+ * @brief N-page LRU read cache
+ */
+class PageCache {
+public:
+  /**
+   * @param pages Number of cached pages
+   * @param pageSize Page size in bytes (match the flash sector, 4096)
+   */
+  PageCache(size_t pages, size_t pageSize);
+  ~PageCache();
+
+  PageCache(const PageCache &) = delete;
+  PageCache &operator=(const PageCache &) = delete;
+
+  /**
+   * @brief Allocate pages and attach the backing reader
+   * @param reader Backing store read
+   * @param limit Size of the backing region (reads are clipped to it)
+   * @return false if allocation failed
+   */
+  bool begin(PageReadFn reader, uint32_t limit);
+
+  /// @brief Release page memory
+  void end();
+
+  /**
+   * @brief Read through the cache
+   * @param offset Byte offset in the backing region
+   * @param out Output buffer
+   * @param len Bytes wanted (may span pages)
+   * @return Bytes read (short only at the limit or on read error)
+   */
+  size_t read(uint32_t offset, uint8_t *out, size_t len);
+
+  const PageCacheStats &getStats() const { return stats_; }
+
+private:
+  struct Page {
+    uint32_t index;
+    uint32_t lastUse;
+    bool valid;
+  };
+
+  size_t pageSize_;
+  uint32_t limit_ = 0;
+  uint32_t clock_ = 0;
+  PageReadFn reader_;
+  std::vector<Page> pages_;
+  uint8_t *data_ = nullptr;
+  PageCacheStats stats_;
+
+  /** @brief Find or load page, nullptr on read error */
+  const uint8_t *lookup(uint32_t pageIndex);
+};
+
+} // namespace W4RP
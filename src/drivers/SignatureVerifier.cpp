@@ -0,0 +1,82 @@
+/**
+ * @file SignatureVerifier.cpp
+ * @brief Streaming firmware signature check implementation
+ */
+
+#include "SignatureVerifier.h"
+#include <Arduino.h>
+#include <esp_log.h>
+
+static const char *TAG = "SignatureVerifier";
+
+namespace W4RP {
+
+SignatureVerifier::SignatureVerifier() {
+  mbedtls_ecp_group_init(&group_);
+  mbedtls_ecp_point_init(&key_);
+  mbedtls_sha256_init(&sha_);
+}
+
+SignatureVerifier::~SignatureVerifier() {
+  mbedtls_sha256_free(&sha_);
+  mbedtls_ecp_point_free(&key_);
+  mbedtls_ecp_group_free(&group_);
+}
+
+bool SignatureVerifier::setPublicKey(const uint8_t *key, size_t len) {
+  hasKey_ = false;
+
+  if (mbedtls_ecp_group_load(&group_, MBEDTLS_ECP_DP_SECP256R1) != 0 ||
+      mbedtls_ecp_point_read_binary(&group_, &key_, key, len) != 0 ||
+      mbedtls_ecp_check_pubkey(&group_, &key_) != 0) {
+    ESP_LOGE(TAG, "Invalid public key");
+    return false;
+  }
+
+  hasKey_ = true;
+  return true;
+}
+
+void SignatureVerifier::begin() {
+  mbedtls_sha256_free(&sha_);
+  mbedtls_sha256_init(&sha_);
+  mbedtls_sha256_starts(&sha_, 0); // 0 = SHA-256, not SHA-224
+  hashUs_ = 0;
+  verifyUs_ = 0;
+}
+
+void SignatureVerifier::update(const uint8_t *data, size_t len) {
+  uint32_t start = micros();
+  mbedtls_sha256_update(&sha_, data, len);
+  hashUs_ += micros() - start;
+}
+
+bool SignatureVerifier::verify(const uint8_t *signature) {
+  if (!hasKey_)
+    return false;
+
+  uint32_t start = micros();
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&sha_, digest);
+
+  mbedtls_mpi r, s;
+  mbedtls_mpi_init(&r);
+  mbedtls_mpi_init(&s);
+
+  int rc = mbedtls_mpi_read_binary(&r, signature, OTA_SIGNATURE_SIZE / 2);
+  if (rc == 0)
+    rc = mbedtls_mpi_read_binary(&s, signature + OTA_SIGNATURE_SIZE / 2,
+                                 OTA_SIGNATURE_SIZE / 2);
+  if (rc == 0)
+    rc = mbedtls_ecdsa_verify(&group_, digest, sizeof(digest), &key_, &r, &s);
+
+  mbedtls_mpi_free(&r);
+  mbedtls_mpi_free(&s);
+  verifyUs_ = micros() - start;
+
+  ESP_LOGI(TAG, "Signature %s (hash %u ms overlapped, verify %u ms)",
+           rc == 0 ? "valid" : "INVALID", hashUs_ / 1000, verifyUs_ / 1000);
+  return rc == 0;
+}
+
+} // namespace W4RP
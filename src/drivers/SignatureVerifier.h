@@ -0,0 +1,79 @@
+/**
+ * @file SignatureVerifier.h
+ * @brief DRIVERS:SignatureVerifier - Streaming firmware signature check
+ * @version 1.0.0
+ *
+ * SHA-256 over the image as it is written to flash, ECDSA P-256 verify
+ * of the digest at the end. The hash is fed from the OTA writer / janpatch
+ * tasks chunk by chunk, so only the final verify (tens of ms) is left
+ * after the last byte. mbedtls uses the ESP32 SHA accelerator when
+ * CONFIG_MBEDTLS_HARDWARE_SHA is set (default).
+ *
+ * Signature format: raw r || s, 32 bytes each, big-endian.
+ * Public key: uncompressed SEC1 point (0x04 || X || Y, 65 bytes).
+ */
+#pragma once
+#include <mbedtls/ecdsa.h>
+#include <mbedtls/sha256.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace W4RP {
+
+#define OTA_SIGNATURE_SIZE 64  ///< r || s
+#define OTA_PUBLIC_KEY_SIZE 65 ///< 0x04 || X || Y
+
+/**
+ * @class SignatureVerifier
+ * @brief Incremental SHA-256 + ECDSA P-256 verification
+ */
+class SignatureVerifier {
+public:
+  SignatureVerifier();
+  ~SignatureVerifier();
+
+  SignatureVerifier(const SignatureVerifier &) = delete;
+  SignatureVerifier &operator=(const SignatureVerifier &) = delete;
+
+  /**
+   * @brief Load the public key (P-256)
+   * @param key Uncompressed SEC1 point
+   * @param len Key length (65)
+   * @return false if the key is not a valid curve point
+   */
+  bool setPublicKey(const uint8_t *key, size_t len);
+
+  /// @brief Check a key is loaded (signatures required)
+  bool hasKey() const { return hasKey_; }
+
+  /// @brief Start a new image hash
+  void begin();
+
+  /**
+   * @brief Hash image bytes, in write order
+   * @param data Image data
+   * @param len Length
+   */
+  void update(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Finish the hash and verify
+   * @param signature r || s (OTA_SIGNATURE_SIZE bytes)
+   * @return true if the signature matches the hashed image
+   */
+  bool verify(const uint8_t *signature);
+
+  /// @brief Time spent hashing / verifying (last image)
+  uint32_t getHashUs() const { return hashUs_; }
+  uint32_t getVerifyUs() const { return verifyUs_; }
+
+private:
+  mbedtls_ecp_group group_;
+  mbedtls_ecp_point key_;
+  mbedtls_sha256_context sha_;
+  bool hasKey_ = false;
+  uint32_t hashUs_ = 0;
+  uint32_t verifyUs_ = 0;
+};
+
+} // namespace W4RP
@@ -7,13 +7,13 @@
  */
 #pragma once
 #include <Arduino.h>
-#include <functional>
+#include "../core/InplaceFunction.h"
 
 namespace W4RP {
 
 using TransportRxCallback =
-    std::function<void(const uint8_t *data, size_t len)>;
-using TransportConnCallback = std::function<void(bool connected)>;
+    InplaceFunction<void(const uint8_t *data, size_t len)>;
+using TransportConnCallback = InplaceFunction<void(bool connected)>;
 
 /**
  * @interface Communication
@@ -80,6 +80,14 @@ public:
    * @return MTU in bytes (default 128)
    */
   virtual size_t getMTU() const { return 128; }
+
+  /**
+   * @brief Number of MTU-sized packets the transport can accept now
+   * Bulk transfers send at most this many chunks before yielding. While
+   * non-zero, send() must take a short message (a reply) whole.
+   * @return Free TX credits (default: unlimited)
+   */
+  virtual size_t txCredits() const { return SIZE_MAX; }
 };
 
 } // namespace W4RP
\ No newline at end of file
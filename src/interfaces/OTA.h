@@ -11,7 +11,7 @@
 #pragma once
 
 #include <Arduino.h>
-#include <functional>
+#include "../core/InplaceFunction.h"
 
 namespace W4RP {
 
@@ -25,7 +25,8 @@ enum class OTAStatus : uint8_t {
   ERROR_CRC,
   ERROR_SIGNATURE,
   ERROR_FLASH,
-  ERROR_TIMEOUT
+  ERROR_TIMEOUT,
+  ERROR_SOURCE ///< Delta: running image CRC != patch source CRC
 };
 
 struct OTAProgress {
@@ -34,8 +35,8 @@ struct OTAProgress {
   uint8_t percentage;
 };
 
-using OTAProgressCallback = std::function<void(const OTAProgress &)>;
-using OTACompleteCallback = std::function<void(OTAStatus)>;
+using OTAProgressCallback = InplaceFunction<void(const OTAProgress &)>;
+using OTACompleteCallback = InplaceFunction<void(OTAStatus)>;
 
 class OTA {
 public:
@@ -52,8 +53,18 @@ public:
   virtual OTAStatus getStatus() const = 0;
   virtual void setProgressCallback(OTAProgressCallback cb) = 0;
   virtual void setCompleteCallback(OTACompleteCallback cb) = 0;
+  /// Advisory: CPU/flash-heavy phase (Controller keeps running rules)
   virtual bool needsPause() const = 0;
   virtual void loop() = 0;
+
+  /// Full image sent as a zlib stream, decompressed on the device
+  /// (compressed size, image size, image CRC32; default: unsupported)
+  virtual bool startCompressedUpdate(uint32_t, uint32_t, uint32_t) {
+    return false;
+  }
+
+  /// Bytes the current update accepts right now without blocking
+  virtual size_t getWindow() const { return SIZE_MAX; }
 };
 
 } // namespace W4RP
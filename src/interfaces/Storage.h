@@ -24,6 +24,18 @@ public:
   virtual String readString(const char *key) = 0;
   virtual bool erase(const char *key) = 0;
   virtual bool commit() { return true; }
+
+  /**
+   * @brief Enable/disable commit after every write (default: no-op)
+   * Pass false to leave commits to the caller.
+   */
+  virtual void setAutoCommit(bool) {}
+
+  /**
+   * @brief Periodic housekeeping (default: no-op)
+   * Called from Controller::loop()
+   */
+  virtual void loop() {}
 };
 
-} // namespace W4RP
\ No newline at end of file
+} // namespace W4RP
@@ -0,0 +1,169 @@
+/**
+ * @file CachedStorageTest.cpp
+ * @brief Host test: CachedStorage write-behind cache
+ *
+ * Backing store is MemStorage with per-key write failures, so the tests
+ * can check what reached it and when.
+ */
+
+#include "Fixtures.h"
+
+using namespace W4RP;
+using namespace W4RP::Test;
+
+// MemStorage where writes (and erases) of one key fail
+class FailingStorage : public MemStorage {
+public:
+  std::string failKey;
+  std::map<std::string, int> keyWrites; // Write attempts per key
+
+  bool writeBlob(const char *key, const uint8_t *data, size_t len) override {
+    keyWrites[key]++;
+    if (failKey == key) {
+      writes++;
+      return false;
+    }
+    return MemStorage::writeBlob(key, data, len);
+  }
+  bool erase(const char *key) override {
+    keyWrites[key]++;
+    if (failKey == key) {
+      writes++;
+      return false;
+    }
+    return MemStorage::erase(key);
+  }
+};
+
+static void writeByte(Storage &storage, const char *key, uint8_t value) {
+  CHECK(storage.writeBlob(key, &value, 1));
+}
+
+// Rewrites of a key collapse into one backing write, and reads see the
+// pending value before it is flushed
+static void testCoalescing() {
+  FailingStorage backing;
+  CachedStorage cache(&backing);
+  CHECK(cache.begin());
+
+  writeByte(cache, "a", 1);
+  writeByte(cache, "a", 2);
+  writeByte(cache, "b", 7);
+  writeByte(cache, "a", 2); // Identical: not a new write
+  CHECK(cache.writeString("s", String("on")));
+  CHECK(cache.erase("b"));
+  CHECK(backing.writes == 0);
+
+  uint8_t value = 0;
+  CHECK(cache.readBlob("a", &value, 1) == 1 && value == 2);
+  CHECK(cache.readBlob("b", &value, 1) == 0); // Pending erase
+  CHECK(cache.readString("s") == "on");
+
+  CHECK(cache.commit());
+  CHECK(backing.keyWrites["a"] == 1);
+  CHECK(backing.keyWrites["b"] == 1); // The erase, not the write
+  CHECK(backing.kv["a"] == std::vector<uint8_t>{2});
+  CHECK(backing.kv.count("b") == 0);
+  CHECK(backing.commits == 1);
+  CHECK(!cache.isDirty());
+
+  CachedStorageStats stats = cache.getStats();
+  CHECK(stats.writes == 6);
+  CHECK(stats.commits == 1);
+  CHECK(stats.commitsAvoided == 4); // 5 value changes, one commit
+  CHECK(stats.bytesWritten == 3);
+  CHECK(stats.pendingBytes == 0);
+
+  CHECK(cache.commit()); // Nothing pending: no backing commit
+  CHECK(backing.commits == 1);
+  printf("coalescing ok\n");
+}
+
+// loop() flushes once the oldest dirty write is flushIntervalMs old; the
+// byte threshold flushes from the write itself
+static void testFlushOnLoop() {
+  FailingStorage backing;
+  CachedStorageConfig config;
+  config.flushIntervalMs = 1000;
+  config.flushThresholdBytes = 64;
+  CachedStorage cache(&backing, config);
+  CHECK(cache.begin());
+
+  writeByte(cache, "a", 1);
+  delay(600);
+  writeByte(cache, "b", 2); // Does not restart the interval
+  cache.loop();
+  CHECK(backing.commits == 0);
+  delay(400);
+  cache.loop();
+  CHECK(backing.commits == 1);
+  CHECK(backing.kv.size() == 2);
+  CHECK(!cache.isDirty());
+
+  cache.loop(); // Clean: nothing to do
+  CHECK(backing.commits == 1);
+
+  uint8_t big[64] = {};
+  CHECK(cache.writeBlob("big", big, sizeof(big)));
+  CHECK(backing.commits == 2);
+  CHECK(!cache.isDirty());
+  printf("flush on loop ok\n");
+}
+
+// A key whose backing write keeps failing stays dirty for maxWriteAttempts
+// flushes, then is dropped; other keys still land and are committed
+static void testDropAfterFailedWrites() {
+  FailingStorage backing;
+  backing.failKey = "bad";
+  CachedStorage cache(&backing);
+  CHECK(cache.begin());
+
+  writeByte(cache, "bad", 1);
+  writeByte(cache, "good", 2);
+
+  CHECK(!cache.commit());
+  CHECK(backing.kv.count("good") == 1);
+  CHECK(backing.commits == 1);
+  CHECK(cache.isDirty());
+  CHECK(cache.getStats().pendingBytes == 1);
+
+  // Only the failing key is left: no backing commit for nothing written
+  CHECK(!cache.commit());
+  CHECK(cache.isDirty());
+  CHECK(!cache.commit());
+  CHECK(!cache.isDirty());
+  CHECK(backing.keyWrites["bad"] == 3);
+  CHECK(backing.commits == 1);
+
+  CachedStorageStats stats = cache.getStats();
+  CHECK(stats.writesDropped == 1);
+  CHECK(stats.commits == 1);
+  CHECK(stats.commitsAvoided == 1); // Two writes in the one real commit
+  CHECK(stats.pendingBytes == 0);
+
+  CHECK(cache.commit()); // Dropped for good
+  CHECK(backing.keyWrites["bad"] == 3);
+
+  // A new value starts its attempts over
+  writeByte(cache, "bad", 3);
+  CHECK(!cache.commit());
+  CHECK(!cache.commit());
+  writeByte(cache, "bad", 4);
+  CHECK(!cache.commit());
+  CHECK(!cache.commit());
+  CHECK(cache.isDirty());
+  backing.failKey.clear();
+  CHECK(cache.commit());
+  CHECK(backing.kv["bad"] == std::vector<uint8_t>{4});
+  CHECK(cache.getStats().writesDropped == 1);
+  CHECK(backing.commits == 2);
+  printf("drop after failed writes ok\n");
+}
+
+int main() {
+  testCoalescing();
+  testFlushOnLoop();
+  testDropAfterFailedWrites();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,15 @@
+/**
+ * @file Check.h
+ * @brief Host tests: assertion that survives NDEBUG
+ */
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);                   \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,110 @@
+/**
+ * @file ConditionBenchmark.cpp
+ * @brief Host benchmark: batched condition kernel vs per-condition switch
+ *
+ * Times ConditionKernel::compare() over operator groups for 32, 256 and
+ * 2048 conditions, and the same conditions evaluated one by one through a
+ * switch on the operator (the Engine before conditions were batched).
+ * A ruleset holds at most 32 conditions (rule masks are 32-bit); the
+ * larger runs show how the kernel scales per call. Not run by ctest:
+ *   ./ConditionBenchmark
+ */
+
+#include "src/core/ConditionKernel.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace W4RP;
+
+static const size_t MAX_CONDITIONS = 2048;
+static const uint32_t CONDITIONS_PER_RUN = 50000000; // Per size
+
+static float values[MAX_CONDITIONS];
+static float value1[MAX_CONDITIONS];
+static float value2[MAX_CONDITIONS];
+static uint32_t bits[MAX_CONDITIONS / 32];
+
+// A mix of groups, as a ruleset would have after grouping by operator
+static const Operation OPS[] = {Operation::GT, Operation::LE, Operation::EQ,
+                                Operation::WITHIN};
+static const size_t OP_COUNT = sizeof(OPS) / sizeof(OPS[0]);
+
+// One condition, as the Engine evaluated it before batching
+static bool evaluateOne(Operation op, float v, float a, float b) {
+  switch (op) {
+  case Operation::EQ:
+    return fabsf(v - a) < ConditionKernel::EPSILON;
+  case Operation::NE:
+    return fabsf(v - a) >= ConditionKernel::EPSILON;
+  case Operation::GT:
+    return v > a;
+  case Operation::GE:
+    return v >= a;
+  case Operation::LT:
+    return v < a;
+  case Operation::LE:
+    return v <= a;
+  case Operation::WITHIN:
+    return v >= a && v <= b;
+  case Operation::OUTSIDE:
+    return v < a || v > b;
+  default:
+    return false;
+  }
+}
+
+static void batched(size_t n) {
+  size_t perGroup = n / OP_COUNT;
+  for (size_t g = 0; g < OP_COUNT; g++) {
+    size_t first = g * perGroup;
+    ConditionKernel::compare(OPS[g], values + first, value1 + first,
+                             value2 + first, perGroup, bits, first);
+  }
+}
+
+static void perCondition(size_t n) {
+  size_t perGroup = n / OP_COUNT;
+  for (size_t i = 0; i < n; i++) {
+    if (evaluateOne(OPS[i / perGroup], values[i], value1[i], value2[i]))
+      bits[i >> 5] |= 1u << (i & 31);
+  }
+}
+
+// Conditions per second; checksum keeps the work live
+static double measure(void (*fn)(size_t), size_t n, uint32_t &checksum) {
+  uint32_t iterations = CONDITIONS_PER_RUN / n;
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t it = 0; it < iterations; it++) {
+    memset(bits, 0, sizeof(bits));
+    fn(n);
+    checksum = checksum * 31 + bits[(n - 1) / 32];
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           t0)
+                 .count();
+  return (double)iterations * n / s;
+}
+
+int main() {
+  // Fixed pseudo-random operands: about half the conditions hold
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < MAX_CONDITIONS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    values[i] = (float)((seed >> 16) % 200) - 100.0f;
+    value1[i] = (float)((seed >> 8) % 200) - 100.0f;
+    value2[i] = value1[i] + 50.0f;
+  }
+
+  const size_t sizes[] = {32, 256, 2048};
+  for (size_t n : sizes) {
+    uint32_t a = 0, b = 0;
+    double kernel = measure(batched, n, a);
+    double sw = measure(perCondition, n, b);
+    printf("%4u conditions: kernel %7.0f M/s  switch %7.0f M/s  %5.2fx%s\n",
+           (unsigned)n, kernel / 1e6, sw / 1e6, kernel / sw,
+           a == b ? "" : "  RESULTS DIFFER");
+  }
+  return 0;
+}
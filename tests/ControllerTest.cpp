@@ -0,0 +1,213 @@
+/**
+ * @file ControllerTest.cpp
+ * @brief Host test: Controller over LoopbackTransport
+ */
+
+#include "Fixtures.h"
+
+using namespace W4RP;
+using namespace W4RP::Test;
+
+static const uint8_t OP_WATCH = (uint8_t)CommandOp::DEBUG_WATCH;
+static const uint8_t OP_RESUME = (uint8_t)CommandOp::RESUME;
+static const uint8_t OP_OTA_CANCEL = (uint8_t)CommandOp::OTA_CANCEL;
+static const uint8_t OP_DEBUG_START = (uint8_t)CommandOp::DEBUG_START;
+static const uint8_t OP_SET_RULES_NVS = (uint8_t)CommandOp::SET_RULES_NVS;
+
+// Watch list text of about len bytes
+static std::string watchList(size_t len) {
+  std::string list;
+  for (int id = 256; list.size() < len; id++) {
+    if (!list.empty())
+      list += ",";
+    list += std::to_string(id) + ":0:8:0:1:0";
+  }
+  return list;
+}
+
+// A client ignoring the window overflows the inbox: the stream must stop
+// at the last contiguous byte, not append later packets after the hole
+static void testInboxOverflow() {
+  FakeCan can;
+  MemStorage storage;
+  LoopbackTransport transport(244, 4);
+  Capture out;
+  out.attach(transport);
+  Controller c(&can, &storage, &transport);
+  c.begin();
+
+  std::string payload = watchList(3000);
+  std::vector<uint8_t> cmd = streamCommand(OP_WATCH, 21, payload);
+  transport.inject(cmd.data(), cmd.size());
+  c.loop();
+  int accepted = out.find(OP_WATCH, 21, CommandStatus::OK);
+  CHECK(accepted >= 0);
+  uint32_t session = out.position(accepted).sessionId;
+
+  // 20 packets in one burst: 16 fit the inbox, 4 are dropped
+  const size_t chunk = 100;
+  for (size_t i = 0; i < 20; i++)
+    transport.inject((const uint8_t *)payload.data() + i * chunk, chunk);
+  CHECK(c.getRxDropped() == 4);
+  c.loop();
+  CHECK(out.find(OP_WATCH, 21, CommandStatus::DATA_LOST) < 0);
+
+  // The next packet follows the hole
+  transport.inject((const uint8_t *)payload.data() + 20 * chunk, chunk);
+  c.loop();
+  int lost = out.find(OP_WATCH, 21, CommandStatus::DATA_LOST);
+  CHECK(lost >= 0);
+  WBPStreamPosition pos = out.position(lost);
+  CHECK(pos.sessionId == session);
+  CHECK(pos.offset == 16 * chunk);
+  CHECK(pos.window == 0);
+
+  // RESUME continues from the last contiguous byte
+  uint8_t resume[6] = {OP_RESUME, 22};
+  memcpy(resume + 2, &session, 4);
+  transport.inject(resume, sizeof(resume));
+  c.loop();
+  int resumed = out.find(OP_RESUME, 22, CommandStatus::OK);
+  CHECK(resumed >= 0);
+  CHECK(out.position(resumed).offset == 16 * chunk);
+
+  for (size_t off = 16 * chunk; off < payload.size(); off += chunk) {
+    transport.inject((const uint8_t *)payload.data() + off,
+                     std::min(chunk, payload.size() - off));
+    c.loop();
+  }
+  transport.inject("END");
+  c.loop();
+
+  // Accept response carries a position, the final one a signal count
+  int done = out.find(OP_WATCH, 21, CommandStatus::OK);
+  CHECK(done > resumed);
+  CHECK(out.packets[done].size() == 4 + sizeof(uint16_t));
+  printf("inbox overflow ok\n");
+}
+
+// Data the client had in flight when the gap hit is dropped until RESUME,
+// even where its first byte looks like a binary command
+static void testDataAfterGapIsNotACommand() {
+  FakeCan can;
+  MemStorage storage;
+  LoopbackTransport transport(244, 4);
+  Capture out;
+  out.attach(transport);
+  Controller c(&can, &storage, &transport);
+  c.begin();
+
+  std::string payload = watchList(3000);
+  std::vector<uint8_t> cmd = streamCommand(OP_WATCH, 31, payload);
+  transport.inject(cmd.data(), cmd.size());
+  c.loop();
+  uint32_t session =
+      out.position(out.find(OP_WATCH, 31, CommandStatus::OK)).sessionId;
+
+  const size_t chunk = 100;
+  for (size_t i = 0; i < 20; i++)
+    transport.inject((const uint8_t *)payload.data() + i * chunk, chunk);
+  c.loop();
+
+  // In-flight packets after the hole: OTA_CANCEL- and SET_RULES-shaped
+  uint8_t cancel[2] = {OP_OTA_CANCEL, 32};
+  transport.inject(cancel, sizeof(cancel));
+  std::vector<uint8_t> rules = streamCommand(OP_SET_RULES_NVS, 33, "x");
+  transport.inject(rules.data(), rules.size());
+  c.loop();
+  CHECK(out.find(OP_WATCH, 31, CommandStatus::DATA_LOST) >= 0);
+  CHECK(out.find(OP_OTA_CANCEL, 32, CommandStatus::UNSUPPORTED) < 0);
+  CHECK(out.find(OP_SET_RULES_NVS, 33, CommandStatus::OK) < 0);
+
+  // The stream survived: RESUME picks it up at the last contiguous byte
+  uint8_t resume[6] = {OP_RESUME, 34};
+  memcpy(resume + 2, &session, 4);
+  transport.inject(resume, sizeof(resume));
+  c.loop();
+  int resumed = out.find(OP_RESUME, 34, CommandStatus::OK);
+  CHECK(resumed >= 0);
+  CHECK(out.position(resumed).offset == 16 * chunk);
+  printf("data after gap ok\n");
+}
+
+// Replies wait in the reply queue until the transport has a credit, in
+// the order they were issued
+static void testRepliesWaitForCredits() {
+  FakeCan can;
+  MemStorage storage;
+  LoopbackTransport transport(244, 0);
+  Capture out;
+  out.attach(transport);
+  Controller c(&can, &storage, &transport);
+  c.begin();
+
+  uint8_t start[2] = {OP_DEBUG_START, 41};
+  transport.inject(start, sizeof(start));
+  c.loop();
+  start[1] = 42;
+  transport.inject(start, sizeof(start));
+  c.loop();
+  CHECK(out.packets.empty());
+
+  transport.setCreditsPerLoop(1);
+  c.loop(); // Credits arrive at the end of this pass
+  c.loop();
+  CHECK(out.packets.size() == 1);
+  c.loop();
+  int first = out.find(OP_DEBUG_START, 41, CommandStatus::OK);
+  int second = out.find(OP_DEBUG_START, 42, CommandStatus::OK);
+  CHECK(first >= 0 && second > first);
+  CHECK(transport.getStats().creditStalls == 0);
+  printf("replies wait for credits ok\n");
+}
+
+// Ordinary replies filling the reply queue cannot crowd out DATA_LOST:
+// the client still learns where to RESUME from
+static void testDataLostNotCrowdedOut() {
+  FakeCan can;
+  MemStorage storage;
+  LoopbackTransport transport(244, 0);
+  Capture out;
+  out.attach(transport);
+  Controller c(&can, &storage, &transport);
+  c.begin();
+
+  // More replies than the queue holds, none sent for lack of credits
+  for (uint8_t id = 50; id < 60; id++) {
+    uint8_t start[2] = {OP_DEBUG_START, id};
+    transport.inject(start, sizeof(start));
+  }
+  c.loop();
+
+  std::string payload = watchList(3000);
+  std::vector<uint8_t> cmd = streamCommand(OP_WATCH, 61, payload);
+  transport.inject(cmd.data(), cmd.size());
+  c.loop();
+
+  const size_t chunk = 100;
+  for (size_t i = 0; i < 20; i++)
+    transport.inject((const uint8_t *)payload.data() + i * chunk, chunk);
+  c.loop();
+  transport.inject((const uint8_t *)payload.data() + 20 * chunk, chunk);
+  c.loop();
+  CHECK(out.packets.empty());
+
+  transport.setCreditsPerLoop(4);
+  for (int i = 0; i < 4; i++)
+    c.loop();
+  int lost = out.find(OP_WATCH, 61, CommandStatus::DATA_LOST);
+  CHECK(lost >= 0);
+  CHECK(out.position(lost).offset == 16 * chunk);
+  CHECK(out.find(OP_DEBUG_START, 50, CommandStatus::OK) >= 0);
+  CHECK(out.find(OP_DEBUG_START, 59, CommandStatus::OK) < 0);
+  printf("data lost not crowded out ok\n");
+}
+
+int main() {
+  testInboxOverflow();
+  testDataAfterGapIsNotACommand();
+  testRepliesWaitForCredits();
+  testDataLostNotCrowdedOut();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file EngineTest.cpp
+ * @brief Host test: Engine debug watch sampling
+ */
+
+#include "Fixtures.h"
+
+using namespace W4RP;
+using namespace W4RP::Test;
+
+static const uint32_t WATCH_ID = 256;
+
+static uint64_t readVarint(const uint8_t *&p) {
+  uint64_t v = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return v;
+  }
+}
+
+// One watched 8-bit signal, with a client decoding the telemetry frames
+class Watch {
+public:
+  explicit Watch(const char *spec) {
+    CHECK(engine_.loadDebugSignals(String(spec)) == 1);
+  }
+
+  Engine &engine() { return engine_; }
+
+  void feed(uint8_t raw) {
+    CanFrame frame = {};
+    frame.id = WATCH_ID;
+    frame.dlc = 8;
+    frame.data[0] = raw;
+    engine_.processCanFrame(frame);
+  }
+
+  // Build one frame; true with the value if the signal was in it
+  bool poll(int64_t &value) {
+    uint8_t buf[64];
+    size_t len = engine_.buildDebugFrame(buf, sizeof(buf), seq_++);
+    if (len == 0)
+      return false;
+    CHECK(buf[0] == WBP_DEBUG_FRAME);
+    if (buf[1] & WBP_DEBUG_FLAG_KEY)
+      baseline_ = 0;
+
+    const uint8_t *p = buf + DebugFrameWriter::HEADER_SIZE;
+    bool found = false;
+    for (uint8_t i = 0; i < buf[3]; i++) {
+      CHECK(readVarint(p) == 0);
+      uint64_t z = readVarint(p);
+      baseline_ += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+      value = baseline_;
+      found = true;
+    }
+    CHECK(p == buf + len);
+    return found;
+  }
+
+private:
+  Engine engine_;
+  uint8_t seq_ = 0;
+  int64_t baseline_ = 0;
+};
+
+// PERIODIC, 100 ms: each mode reports its aggregate over the interval
+static void testAggregateOverInterval() {
+  const struct {
+    const char *spec;
+    int64_t expected;
+  } cases[] = {
+      {"256:0:8:0:1:0:100:0:1:0", 70}, // LAST
+      {"256:0:8:0:1:0:100:0:1:1", 10}, // MIN
+      {"256:0:8:0:1:0:100:0:1:2", 70}, // MAX
+      {"256:0:8:0:1:0:100:0:1:3", 43}, // AVG of 50, 10, 70
+  };
+
+  for (const auto &c : cases) {
+    Watch w(c.spec);
+    int64_t value = -1;
+    w.feed(0);
+    CHECK(w.poll(value) && value == 0);
+
+    const uint8_t samples[] = {50, 10, 70};
+    for (uint8_t s : samples) {
+      delay(30);
+      w.feed(s);
+      CHECK(!w.poll(value));
+    }
+    delay(10);
+    CHECK(w.poll(value));
+    CHECK(value == c.expected);
+  }
+  printf("aggregate over interval ok\n");
+}
+
+// ON_CHANGE: an interval where nothing was sent still ends, so a step is
+// reported within two intervals even when the old aggregate matched the
+// last sent value
+static void testWindowClosesWithoutSend() {
+  const struct {
+    const char *spec;
+    uint8_t from, to;
+  } cases[] = {
+      {"256:0:8:0:1:0:100:0.5:0:0", 0, 100}, // LAST
+      {"256:0:8:0:1:0:100:0.5:0:1", 0, 100}, // MIN
+      {"256:0:8:0:1:0:100:0.5:0:2", 100, 0}, // MAX
+      {"256:0:8:0:1:0:100:0.5:0:3", 0, 100}, // AVG
+  };
+
+  for (const auto &c : cases) {
+    Watch w(c.spec);
+    int64_t value = -1;
+    w.feed(c.from);
+    CHECK(w.poll(value) && value == c.from);
+
+    // Steady for a while, then a step; sampled and polled every 10 ms
+    uint32_t sends = 0;
+    for (int t = 10; t <= 250; t += 10) {
+      delay(10);
+      w.feed(c.from);
+      if (w.poll(value))
+        sends++;
+    }
+    CHECK(sends == 0);
+
+    bool reported = false;
+    for (int t = 10; t <= 200 && !reported; t += 10) {
+      delay(10);
+      w.feed(c.to);
+      reported = w.poll(value) && value == c.to;
+    }
+    CHECK(reported);
+  }
+  printf("window closes without send ok\n");
+}
+
+// A watched signal sharing a ruleset decode: ingest decodes it once for
+// the watch, and rules read that same decode
+static void testSharedDecode() {
+  int hits = 0;
+  RulesetBuilder rb;
+  rb.signals.push_back({WATCH_ID, 0, 8, 0, 1.0f, 0.0f});
+  rb.conditions.push_back({0, (uint8_t)Operation::GT, 0, 50.0f, 0});
+  rb.actions.push_back({rb.str("hit"), 0, 0, 0});
+  rb.rules.push_back({0, 0x1, 0, 1, 0, 0});
+  std::vector<uint8_t> bin = rb.build();
+
+  Watch w("256:0:8:0:1:0:0:0:1:0");
+  Engine &engine = w.engine();
+  engine.registerCapability("hit", [&hits](const ParamMap &) { hits++; });
+  CHECK(engine.loadRuleset(bin.data(), bin.size()));
+  CHECK(engine.loadDebugSignals(String("256:0:8:0:1:0:0:0:1:0")) == 1);
+
+  const uint8_t samples[] = {10, 60, 60, 20, 90};
+  const int expectedHits[] = {0, 1, 2, 2, 3}; // Fires while above 50
+  for (size_t i = 0; i < sizeof(samples); i++) {
+    delay(10);
+    w.feed(samples[i]);
+    engine.evaluateRules();
+    CHECK(hits == expectedHits[i]);
+    int64_t value = -1;
+    CHECK(w.poll(value) && value == samples[i]);
+  }
+  printf("shared decode ok\n");
+}
+
+int main() {
+  testAggregateOverInterval();
+  testWindowClosesWithoutSend();
+  testSharedDecode();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file Fixtures.h
+ * @brief Host tests: in-memory CAN bus, storage and response capture
+ */
+#pragma once
+#include "Check.h"
+#include <W4RP.h>
+#include <esp_crc.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace W4RP {
+namespace Test {
+
+/// CAN bus fed by the test
+class FakeCan : public CAN {
+public:
+  std::deque<CanFrame> rx;
+
+  bool begin() override { return true; }
+  bool receive(CanFrame &frame) override {
+    if (rx.empty())
+      return false;
+    frame = rx.front();
+    rx.pop_front();
+    return true;
+  }
+  bool transmit(const CanFrame &) override { return true; }
+  void stop() override {}
+  void resume() override {}
+  bool isRunning() const override { return true; }
+
+  void push(uint32_t id, const uint8_t *data, uint8_t dlc = 8) {
+    CanFrame frame = {};
+    frame.id = id;
+    frame.dlc = dlc;
+    memcpy(frame.data, data, dlc);
+    rx.push_back(frame);
+  }
+};
+
+/// Key-value storage in RAM; failWrites makes every write fail
+class MemStorage : public Storage {
+public:
+  std::map<std::string, std::vector<uint8_t>> kv;
+  int commits = 0;
+  int writes = 0;
+  bool failWrites = false;
+
+  bool begin() override { return true; }
+  bool writeBlob(const char *key, const uint8_t *data, size_t len) override {
+    writes++;
+    if (failWrites)
+      return false;
+    kv[key].assign(data, data + len);
+    return true;
+  }
+  size_t readBlob(const char *key, uint8_t *buffer, size_t maxLen) override {
+    auto it = kv.find(key);
+    if (it == kv.end())
+      return 0;
+    if (!buffer)
+      return it->second.size();
+    size_t n = std::min(maxLen, it->second.size());
+    memcpy(buffer, it->second.data(), n);
+    return n;
+  }
+  bool writeString(const char *key, const String &value) override {
+    return writeBlob(key, (const uint8_t *)value.c_str(), value.length());
+  }
+  String readString(const char *key) override {
+    auto it = kv.find(key);
+    if (it == kv.end())
+      return String();
+    return String((const char *)it->second.data(), it->second.size());
+  }
+  bool erase(const char *key) override {
+    writes++;
+    if (failWrites)
+      return false;
+    kv.erase(key);
+    return true;
+  }
+  bool commit() override {
+    commits++;
+    return true;
+  }
+};
+
+/// Everything the Controller sent on the TX channel, one entry per packet
+struct Capture {
+  std::vector<std::string> packets;
+
+  void attach(LoopbackTransport &transport) {
+    transport.setTap([this](bool status, const uint8_t *data, size_t len) {
+      if (!status)
+        packets.push_back(std::string((const char *)data, len));
+    });
+  }
+
+  /// Binary response (0xD2) for opcode / request ID with the given status
+  bool isResponse(size_t i, uint8_t op, uint8_t id, CommandStatus status) const {
+    if (i >= packets.size() || packets[i].size() < 4)
+      return false;
+    const std::string &p = packets[i];
+    return (uint8_t)p[0] == WBP_CMD_RESPONSE && (uint8_t)p[1] == op &&
+           (uint8_t)p[2] == id && (uint8_t)p[3] == (uint8_t)status;
+  }
+
+  /// Index of the last matching response, -1 if none
+  int find(uint8_t op, uint8_t id, CommandStatus status) const {
+    for (size_t i = packets.size(); i-- > 0;) {
+      if (isResponse(i, op, id, status))
+        return (int)i;
+    }
+    return -1;
+  }
+
+  /// Stream position carried by response i
+  WBPStreamPosition position(size_t i) const {
+    WBPStreamPosition pos = {};
+    CHECK(packets[i].size() >= 4 + sizeof(pos));
+    memcpy(&pos, packets[i].data() + 4, sizeof(pos));
+    return pos;
+  }
+};
+
+/// Binary stream command: opcode, request ID, length, CRC32 of payload
+inline std::vector<uint8_t> streamCommand(uint8_t op, uint8_t id,
+                                          const std::string &payload) {
+  std::vector<uint8_t> cmd(10);
+  cmd[0] = op;
+  cmd[1] = id;
+  uint32_t len = payload.size();
+  uint32_t crc =
+      esp_crc32_le(0, (const uint8_t *)payload.data(), payload.size());
+  memcpy(&cmd[2], &len, 4);
+  memcpy(&cmd[6], &crc, 4);
+  return cmd;
+}
+
+/// Binary WBP ruleset assembled from its tables
+struct RulesetBuilder {
+  std::vector<WBPSignal> signals;
+  std::vector<WBPCondition> conditions;
+  std::vector<WBPAction> actions;
+  std::vector<WBPActionParam> params;
+  std::vector<WBPRule> rules;
+  std::string strings;
+
+  /// Add to the string table, return its index
+  uint16_t str(const char *s) {
+    uint16_t idx = strings.size();
+    strings += s;
+    strings.push_back('\0');
+    return idx;
+  }
+
+  std::vector<uint8_t> build() {
+    std::vector<uint8_t> out(sizeof(WBPRulesHeader));
+    append(out, signals);
+    append(out, conditions);
+    append(out, actions);
+    append(out, params);
+    append(out, rules);
+    uint16_t stringOffset = out.size();
+    if (strings.empty())
+      strings.push_back('\0');
+    out.insert(out.end(), strings.begin(), strings.end());
+
+    WBPRulesHeader h = {};
+    h.magic = WBP_MAGIC_RULES;
+    h.version = WBP_VERSION;
+    h.totalSize = out.size();
+    h.signalCount = signals.size();
+    h.conditionCount = conditions.size();
+    h.actionCount = actions.size();
+    h.ruleCount = rules.size();
+    h.actionParamCount = params.size();
+    h.stringTableOffset = stringOffset;
+    h.crc32 = esp_crc32_le(0, out.data() + sizeof(h), out.size() - sizeof(h));
+    memcpy(out.data(), &h, sizeof(h));
+    return out;
+  }
+
+private:
+  template <typename T>
+  static void append(std::vector<uint8_t> &out, const std::vector<T> &v) {
+    const uint8_t *p = (const uint8_t *)v.data();
+    out.insert(out.end(), p, p + v.size() * sizeof(T));
+  }
+};
+
+} // namespace Test
+} // namespace W4RP
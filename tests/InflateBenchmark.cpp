@@ -0,0 +1,114 @@
+/**
+ * @file InflateBenchmark.cpp
+ * @brief Host benchmark: compressed full-image OTA on real builds
+ *
+ * Compresses a firmware image (miniz, level 9) and decompresses it through
+ * InflateStream in BLE-sized pieces, the way the OTA writer task does.
+ * Prints the compression ratio and decompress throughput, and checks the
+ * output against the image.
+ *
+ *   ./InflateBenchmark firmware.bin [firmware.bin.z]
+ *
+ * With firmware.bin.z (e.g. from the python one-liner in ota.md) that
+ * stream is decompressed instead. Built only when miniz is found
+ * (-DMINIZ_DIR=<dir with miniz.h and miniz*.c>).
+ */
+
+#include "src/drivers/InflateStream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "miniz.h"
+
+using namespace W4RP;
+
+static const size_t CHUNK = 244;        // Default MTU payload
+static const double MIN_RUN_MS = 500.0; // Repeat until timing is stable
+
+static bool readFile(const char *path, std::vector<uint8_t> &out) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  out.resize(ftell(f));
+  fseek(f, 0, SEEK_SET);
+  bool ok = fread(out.data(), 1, out.size(), f) == out.size();
+  fclose(f);
+  return ok;
+}
+
+// One full pass; out collects the decompressed image
+static bool inflateOnce(const std::vector<uint8_t> &z,
+                        std::vector<uint8_t> &out) {
+  out.clear();
+  InflateStream inflater(4096);
+  if (!inflater.begin([&out](const uint8_t *data, size_t len) {
+        out.insert(out.end(), data, data + len);
+        return true;
+      }))
+    return false;
+
+  InflateResult result = InflateResult::NEED_INPUT;
+  for (size_t ofs = 0; ofs < z.size(); ofs += CHUNK) {
+    size_t n = (z.size() - ofs < CHUNK) ? z.size() - ofs : CHUNK;
+    result = inflater.write(z.data() + ofs, n);
+    if (result != InflateResult::NEED_INPUT && result != InflateResult::DONE)
+      return false;
+  }
+  return result == InflateResult::DONE;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: %s firmware.bin [firmware.bin.z]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> image, z;
+  if (!readFile(argv[1], image)) {
+    printf("cannot read %s\n", argv[1]);
+    return 1;
+  }
+
+  if (argc > 2) {
+    if (!readFile(argv[2], z)) {
+      printf("cannot read %s\n", argv[2]);
+      return 1;
+    }
+  } else {
+    mz_ulong zlen = mz_compressBound(image.size());
+    z.resize(zlen);
+    if (mz_compress2(z.data(), &zlen, image.data(), image.size(), 9) !=
+        MZ_OK) {
+      printf("compression failed\n");
+      return 1;
+    }
+    z.resize(zlen);
+  }
+
+  std::vector<uint8_t> out;
+  int passes = 0;
+  double ms = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  do {
+    if (!inflateOnce(z, out) || out != image) {
+      printf("decompressed output differs from %s\n", argv[1]);
+      return 1;
+    }
+    passes++;
+    ms = std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - t0)
+             .count();
+  } while (ms < MIN_RUN_MS);
+
+  double perPassMs = ms / passes;
+  printf("%s: %zu -> %zu bytes (%.1f%%, %.2fx)\n", argv[1], image.size(),
+         z.size(), 100.0 * z.size() / image.size(),
+         (double)image.size() / z.size());
+  printf("inflate: %.2f ms per image, %.1f MB/s out (%zu-byte writes, "
+         "%d passes)\n",
+         perPassMs, image.size() / perPassMs / 1000.0, CHUNK, passes);
+  return 0;
+}
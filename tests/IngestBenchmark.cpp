@@ -0,0 +1,72 @@
+/**
+ * @file IngestBenchmark.cpp
+ * @brief Host benchmark: CAN ingest + evaluation, lazy vs eager decode
+ *
+ * Built twice, as IngestBenchmark (W4RP_LAZY_DECODE 1) and
+ * IngestBenchmarkEager (W4RP_LAZY_DECODE 0). Not run by ctest; configure
+ * with -DCMAKE_BUILD_TYPE=Release and compare the two:
+ *   ./IngestBenchmark && ./IngestBenchmarkEager
+ *
+ * 8 scaled signals on one CAN ID, 10 frames per evaluateRules(), payload
+ * changing every 4th frame. The "watched" run also has all 8 signals on
+ * the debug watch list, sharing the ruleset decode.
+ */
+
+#include "Fixtures.h"
+#include <chrono>
+
+using namespace W4RP;
+using namespace W4RP::Test;
+
+static const int FRAMES = 2000000;
+static const int FRAMES_PER_EVAL = 10;
+
+static void run(const char *name, bool watched) {
+  Engine engine;
+  engine.registerCapability("hit", [](const ParamMap &) {});
+
+  RulesetBuilder rb;
+  for (int s = 0; s < 8; s++)
+    rb.signals.push_back({0x100, (uint16_t)(s * 8), 8, 0, 0.5f, 1.0f});
+  for (int s = 0; s < 8; s++)
+    rb.conditions.push_back({(uint8_t)s, (uint8_t)Operation::GT, 0, 50.0f, 0});
+  rb.actions.push_back({rb.str("hit"), 0, 0, 0});
+  rb.rules.push_back({0, 0xFF, 0, 1, 0, 0});
+  std::vector<uint8_t> bin = rb.build();
+  CHECK(engine.loadRuleset(bin.data(), bin.size()));
+
+  if (watched) {
+    std::string list;
+    for (int s = 0; s < 8; s++)
+      list += (s ? ",256:" : "256:") + std::to_string(s * 8) + ":8:0:0.5:1";
+    CHECK(engine.loadDebugSignals(String(list.c_str())) == 8);
+  }
+
+  uint8_t frame[64];
+  CanFrame f = {};
+  f.id = 0x100;
+  f.dlc = 8;
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < FRAMES; i++) {
+    memset(f.data, (i / 4) & 0xFF, sizeof(f.data));
+    engine.processCanFrame(f);
+    if (i % FRAMES_PER_EVAL == FRAMES_PER_EVAL - 1) {
+      engine.evaluateRules();
+      if (watched)
+        engine.buildDebugFrame(frame, sizeof(frame), 0);
+    }
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - t0)
+                  .count();
+
+  printf("LAZY=%d %-8s %8.1f ms  (%u rules triggered)\n", W4RP_LAZY_DECODE,
+         name, ms, (unsigned)engine.getRulesTriggered());
+}
+
+int main() {
+  run("rules", false);
+  run("watched", true);
+  return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file PacketRingTest.cpp
+ * @brief Host test: PacketRing SPSC inbox
+ *
+ * Single-threaded checks for multi-slot packets, the full ring and the
+ * after-gap flag, then a producer / consumer stress run on two threads.
+ * Built with -fsanitize=thread (see CMakeLists.txt).
+ */
+
+#include "PacketRing.h"
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace W4RP;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);                   \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+typedef PacketRing<8, 16> SmallRing;
+
+// Packet n: 4-byte sequence number, then a pattern derived from it
+static size_t packetLen(uint32_t seq, size_t maxLen) {
+  return 4 + (seq * 37u) % (maxLen - 3);
+}
+
+static void makePacket(uint32_t seq, uint8_t *out, size_t len) {
+  memcpy(out, &seq, 4);
+  for (size_t i = 4; i < len; i++)
+    out[i] = (uint8_t)(seq + i);
+}
+
+static bool checkPacket(const std::vector<uint8_t> &pkt, uint32_t &seq) {
+  if (pkt.size() < 4)
+    return false;
+  memcpy(&seq, pkt.data(), 4);
+  for (size_t i = 4; i < pkt.size(); i++) {
+    if (pkt[i] != (uint8_t)(seq + i))
+      return false;
+  }
+  return true;
+}
+
+// Consumer side: reassemble CONTINUED slots, first = flags of the first
+// slot. Slots of one packet are published together, so a packet is never
+// seen half-written. Returns false when empty.
+template <typename Ring>
+static bool readPacket(Ring &ring, std::vector<uint8_t> &out, uint8_t &first) {
+  typename Ring::Packet slot;
+  out.clear();
+  for (bool head = true;; head = false) {
+    if (!ring.front(slot)) {
+      CHECK(head);
+      return false;
+    }
+    out.insert(out.end(), slot.data, slot.data + slot.len);
+    if (head)
+      first = slot.flags;
+    ring.pop();
+    if (!(slot.flags & W4RP_PACKET_CONTINUED))
+      return true;
+  }
+}
+
+static void testMultiSlot() {
+  SmallRing ring;
+  uint8_t data[40];
+  makePacket(7, data, sizeof(data)); // 3 slots: 16 + 16 + 8
+
+  CHECK(ring.push(data, sizeof(data)));
+  CHECK(ring.size() == 3);
+
+  SmallRing::Packet slot;
+  CHECK(ring.front(slot) && slot.len == 16 &&
+        slot.flags == W4RP_PACKET_CONTINUED);
+  ring.pop();
+  CHECK(ring.front(slot) && slot.len == 16 &&
+        slot.flags == W4RP_PACKET_CONTINUED);
+  ring.pop();
+  CHECK(ring.front(slot) && slot.len == 8 && slot.flags == W4RP_PACKET_DATA);
+  CHECK(memcmp(slot.data, data + 32, 8) == 0);
+  ring.pop();
+  CHECK(!ring.front(slot));
+
+  // Zero-length events take one slot
+  CHECK(ring.push(nullptr, 0, W4RP_PACKET_DISCONNECT));
+  CHECK(ring.front(slot) && slot.len == 0 &&
+        slot.flags == W4RP_PACKET_DISCONNECT);
+  ring.pop();
+  printf("multi-slot ok\n");
+}
+
+static void testFullRing() {
+  SmallRing ring;
+  uint8_t data[48];
+
+  // 2 x 3 slots, then a 3-slot packet does not fit in the 2 left
+  makePacket(1, data, 48);
+  CHECK(ring.push(data, 48));
+  makePacket(2, data, 48);
+  CHECK(ring.push(data, 48));
+  makePacket(3, data, 48);
+  CHECK(!ring.push(data, 48)); // All-or-nothing
+  CHECK(ring.size() == 6);
+  CHECK(ring.dropped() == 1);
+
+  // Still fits: 2 slots. Then full.
+  makePacket(4, data, 32);
+  CHECK(ring.push(data, 32));
+  makePacket(5, data, 1);
+  CHECK(!ring.push(data, 1));
+  CHECK(ring.dropped() == 2);
+
+  // Expected order: 1, 2, 4 (after the gap left by 3). 5 is still missing.
+  std::vector<uint8_t> pkt;
+  uint8_t first;
+  uint32_t seq;
+  CHECK(readPacket(ring, pkt, first) && checkPacket(pkt, seq) && seq == 1);
+  CHECK(first == W4RP_PACKET_CONTINUED);
+  CHECK(readPacket(ring, pkt, first) && checkPacket(pkt, seq) && seq == 2);
+  CHECK(first == W4RP_PACKET_CONTINUED);
+  CHECK(readPacket(ring, pkt, first) && checkPacket(pkt, seq) && seq == 4);
+  CHECK(first == (W4RP_PACKET_CONTINUED | W4RP_PACKET_AFTER_GAP));
+  CHECK(!readPacket(ring, pkt, first));
+
+  // The loss of 5 is reported on the next packet, then the flag clears
+  makePacket(6, data, 4);
+  CHECK(ring.push(data, 4));
+  makePacket(7, data, 4);
+  CHECK(ring.push(data, 4));
+  CHECK(readPacket(ring, pkt, first) && first == W4RP_PACKET_AFTER_GAP);
+  CHECK(checkPacket(pkt, seq) && seq == 6);
+  CHECK(readPacket(ring, pkt, first) && first == W4RP_PACKET_DATA);
+
+  // Events carry it too
+  for (int i = 0; i < 8; i++)
+    CHECK(ring.push(data, 4));
+  CHECK(!ring.push(data, 4));
+  for (int i = 0; i < 8; i++)
+    CHECK(readPacket(ring, pkt, first) && first == W4RP_PACKET_DATA);
+  CHECK(ring.push(nullptr, 0, W4RP_PACKET_DISCONNECT));
+  CHECK(readPacket(ring, pkt, first) &&
+        first == (W4RP_PACKET_DISCONNECT | W4RP_PACKET_AFTER_GAP));
+  CHECK(ring.dropped() == 3);
+  printf("full ring ok\n");
+}
+
+// Producer side: wait until the consumer has freed enough slots. A failed
+// push counts as a drop, so a lossless producer must not just retry.
+template <typename Ring>
+static void waitForRoom(Ring &ring, size_t slots, size_t needed) {
+  while (slots - ring.size() < needed)
+    std::this_thread::yield();
+}
+
+// Producer pushes count packets of 1..3 slots on its own thread.
+// lossless: wait for room before each push; otherwise drop and move on.
+template <typename Ring, size_t Slots, size_t SlotSize>
+static void stress(uint32_t count, bool lossless) {
+  Ring &ring = *new Ring(); // Large rings do not belong on the stack
+
+  std::thread producer([&ring, count, lossless] {
+    uint8_t data[3 * SlotSize];
+    for (uint32_t seq = 0; seq < count; seq++) {
+      size_t len = packetLen(seq, sizeof(data));
+      makePacket(seq, data, len);
+      if (lossless)
+        waitForRoom(ring, Slots, (len + SlotSize - 1) / SlotSize);
+      else if (seq % 8 == 0)
+        std::this_thread::yield(); // Let some bursts through
+      ring.push(data, len);
+    }
+    waitForRoom(ring, Slots, 1); // End marker, never dropped
+    CHECK(ring.push(nullptr, 0, W4RP_PACKET_DISCONNECT));
+  });
+
+  std::vector<uint8_t> pkt;
+  uint8_t first = 0;
+  uint32_t expected = 0;
+  uint32_t received = 0;
+  for (;;) {
+    if (!readPacket(ring, pkt, first)) {
+      std::this_thread::yield();
+      continue;
+    }
+    bool gap = (first & W4RP_PACKET_AFTER_GAP) != 0;
+    CHECK(!(lossless && gap));
+    if (first & W4RP_PACKET_DISCONNECT) {
+      CHECK(gap == (expected != count)); // Tail loss shows up here
+      break;
+    }
+
+    uint32_t seq;
+    CHECK(checkPacket(pkt, seq));
+    CHECK(pkt.size() == packetLen(seq, 3 * SlotSize));
+    // Contiguous exactly when not flagged
+    CHECK(gap ? seq > expected : seq == expected);
+    expected = seq + 1;
+    received++;
+  }
+  producer.join();
+
+  CHECK(received + ring.dropped() == count);
+  if (lossless)
+    CHECK(ring.dropped() == 0);
+  printf("stress %s: %u received, %u dropped\n",
+         lossless ? "lossless" : "lossy", received, ring.dropped());
+  delete &ring;
+}
+
+int main() {
+  testMultiSlot();
+  testFullRing();
+  stress<SmallRing, 8, 16>(200000, true);
+  stress<SmallRing, 8, 16>(200000, false);
+  stress<PacketRing<16, 244>, 16, 244>(100000, true);
+  stress<PacketRing<16, 244>, 16, 244>(100000, false);
+  printf("OK\n");
+  return 0;
+}
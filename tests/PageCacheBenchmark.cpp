@@ -0,0 +1,203 @@
+/**
+ * @file PageCacheBenchmark.cpp
+ * @brief Host benchmark: delta source cache on real firmware pairs
+ *
+ * Applies a janpatch (JojoDiff) patch the way ESP32OTAService does: 1 KB
+ * janpatch buffers, source reads through PageCache with
+ * OTA_SOURCE_PAGE_SIZE pages. A file stands in for the running
+ * partition. Runs once per cache size and prints the hit rate and the
+ * bytes read from the backing store.
+ *
+ *   jdiff -b old.bin new.bin patch.jdiff
+ *   ./PageCacheBenchmark old.bin patch.jdiff [new.bin]
+ *
+ * With new.bin the patched output is compared against it. Built only
+ * when janpatch.h is found (library root, or -DJANPATCH_DIR=...).
+ */
+
+#include "src/drivers/PageCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "janpatch.h"
+
+using namespace W4RP;
+
+// Same as ESP32OTAService
+#ifndef JANPATCH_PAGE_SIZE
+#define JANPATCH_PAGE_SIZE 1024
+#endif
+#ifndef OTA_SOURCE_PAGE_SIZE
+#define OTA_SOURCE_PAGE_SIZE 4096
+#endif
+
+// One of the three janpatch streams, passed to the callbacks as FILE *
+struct HostStream {
+  FILE *file;                   // Patch
+  PageCache *cache;             // Source
+  std::vector<uint8_t> *target; // Target
+  long offset;
+  long size;
+};
+
+static size_t host_fread(void *ptr, size_t size, size_t count,
+                         FILE *stream) {
+  HostStream *s = reinterpret_cast<HostStream *>(stream);
+  size_t total = size * count;
+  size_t read = 0;
+
+  if (s->cache) {
+    read = s->cache->read(s->offset, (uint8_t *)ptr, total);
+  } else if (s->file) {
+    fseek(s->file, s->offset, SEEK_SET);
+    read = fread(ptr, 1, total, s->file);
+  }
+  s->offset += read;
+  return read / size;
+}
+
+static size_t host_fwrite(const void *ptr, size_t size, size_t count,
+                          FILE *stream) {
+  HostStream *s = reinterpret_cast<HostStream *>(stream);
+  size_t total = size * count;
+  if (!s->target)
+    return 0;
+
+  if (s->target->size() < (size_t)s->offset + total)
+    s->target->resize(s->offset + total);
+  memcpy(s->target->data() + s->offset, ptr, total);
+  s->offset += total;
+  return count;
+}
+
+static int host_fseek(FILE *stream, long offset, int origin) {
+  HostStream *s = reinterpret_cast<HostStream *>(stream);
+  switch (origin) {
+  case SEEK_SET:
+    s->offset = offset;
+    break;
+  case SEEK_CUR:
+    s->offset += offset;
+    break;
+  case SEEK_END:
+    s->offset = s->size + offset;
+    break;
+  }
+  return 0;
+}
+
+static long host_ftell(FILE *stream) {
+  return reinterpret_cast<HostStream *>(stream)->offset;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &out) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  out.resize(ftell(f));
+  fseek(f, 0, SEEK_SET);
+  bool ok = fread(out.data(), 1, out.size(), f) == out.size();
+  fclose(f);
+  return ok;
+}
+
+static bool run(size_t pages, const std::vector<uint8_t> &source,
+                FILE *patch, long patchSize,
+                const std::vector<uint8_t> *expected) {
+  uint64_t backingBytes = 0;
+  PageCache cache(pages, OTA_SOURCE_PAGE_SIZE);
+  bool ok = cache.begin(
+      [&source, &backingBytes](uint32_t address, uint8_t *out, size_t len) {
+        memcpy(out, source.data() + address, len);
+        backingBytes += len;
+        return true;
+      },
+      source.size());
+  if (!ok)
+    return false;
+
+  std::vector<uint8_t> target;
+  HostStream sourceStream = {};
+  sourceStream.cache = &cache;
+  sourceStream.size = source.size();
+  HostStream patchStream = {};
+  patchStream.file = patch;
+  patchStream.size = patchSize;
+  HostStream targetStream = {};
+  targetStream.target = &target;
+
+  std::vector<uint8_t> buffer1(JANPATCH_PAGE_SIZE);
+  std::vector<uint8_t> buffer2(JANPATCH_PAGE_SIZE);
+
+  janpatch_ctx ctx = {};
+  ctx.fread = host_fread;
+  ctx.fwrite = host_fwrite;
+  ctx.fseek = host_fseek;
+  ctx.ftell = host_ftell;
+  ctx.source_buffer.buffer = buffer1.data();
+  ctx.source_buffer.size = JANPATCH_PAGE_SIZE;
+  ctx.patch_buffer.buffer = buffer2.data();
+  ctx.patch_buffer.size = JANPATCH_PAGE_SIZE;
+
+  auto t0 = std::chrono::steady_clock::now();
+  int result = janpatch(ctx, (FILE *)&sourceStream, (FILE *)&patchStream,
+                        (FILE *)&targetStream);
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - t0)
+                  .count();
+
+  const PageCacheStats &stats = cache.getStats();
+  uint32_t lookups = stats.hits + stats.misses;
+  printf("%2u pages: %8u hits %7u misses %7u evictions  %5.1f%% hits  "
+         "%6.2fx source read  %7.1f ms\n",
+         (unsigned)pages, stats.hits, stats.misses, stats.evictions,
+         lookups ? 100.0 * stats.hits / lookups : 0.0,
+         source.empty() ? 0.0 : (double)backingBytes / source.size(), ms);
+
+  if (result != 0) {
+    printf("janpatch failed: %d\n", result);
+    return false;
+  }
+  if (expected && target != *expected) {
+    printf("output differs from the expected image\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printf("usage: %s old.bin patch.jdiff [new.bin]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> source, expected;
+  if (!readFile(argv[1], source) ||
+      (argc > 3 && !readFile(argv[3], expected))) {
+    printf("cannot read input files\n");
+    return 1;
+  }
+  FILE *patch = fopen(argv[2], "rb");
+  if (!patch) {
+    printf("cannot open %s\n", argv[2]);
+    return 1;
+  }
+  fseek(patch, 0, SEEK_END);
+  long patchSize = ftell(patch);
+
+  printf("source %zu bytes, patch %ld bytes, %u-byte pages\n", source.size(),
+         patchSize, OTA_SOURCE_PAGE_SIZE);
+
+  const size_t sizes[] = {1, 2, 4, 8, 16};
+  bool ok = true;
+  for (size_t pages : sizes) {
+    if (!run(pages, source, patch, patchSize, argc > 3 ? &expected : nullptr))
+      ok = false;
+  }
+
+  fclose(patch);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file PageCacheTest.cpp
+ * @brief Host test: PageCache LRU read cache
+ *
+ * Backing store is a byte pattern in RAM; every backing read is logged so
+ * the tests can check exactly which pages were (re)loaded.
+ */
+
+#include "Check.h"
+#include "src/drivers/PageCache.h"
+#include <cstring>
+#include <vector>
+
+using namespace W4RP;
+
+static const size_t PAGE = 16;
+
+// Pattern backing store with a read log and an optional failing page
+struct Backing {
+  std::vector<uint8_t> bytes;
+  std::vector<uint32_t> reads; // Address of each backing read
+  std::vector<size_t> lens;
+  int failPage = -1;
+
+  explicit Backing(size_t size) : bytes(size) {
+    for (size_t i = 0; i < size; i++)
+      bytes[i] = (uint8_t)(i * 7 + 3);
+  }
+
+  PageReadFn reader() {
+    return [this](uint32_t address, uint8_t *out, size_t len) {
+      reads.push_back(address);
+      lens.push_back(len);
+      if ((int)(address / PAGE) == failPage)
+        return false;
+      memcpy(out, bytes.data() + address, len);
+      return true;
+    };
+  }
+
+  bool matches(uint32_t offset, const uint8_t *data, size_t len) const {
+    return memcmp(bytes.data() + offset, data, len) == 0;
+  }
+};
+
+// Repeat reads of a page, and reads spanning pages, are served from RAM
+static void testHits() {
+  Backing store(8 * PAGE);
+  PageCache cache(2, PAGE);
+  CHECK(cache.begin(store.reader(), store.bytes.size()));
+
+  uint8_t out[PAGE * 2];
+  CHECK(cache.read(3, out, 5) == 5);
+  CHECK(store.matches(3, out, 5));
+  CHECK(cache.read(10, out, 6) == 6);
+  CHECK(store.matches(10, out, 6));
+  CHECK(store.reads.size() == 1);
+
+  // Spans pages 0 and 1: one new backing read, the whole range in one call
+  CHECK(cache.read(8, out, PAGE) == PAGE);
+  CHECK(store.matches(8, out, PAGE));
+  CHECK(store.reads.size() == 2 && store.reads[1] == PAGE);
+
+  const PageCacheStats &stats = cache.getStats();
+  CHECK(stats.hits == 2);
+  CHECK(stats.misses == 2);
+  CHECK(stats.evictions == 0);
+  printf("hits ok\n");
+}
+
+// The least recently used page goes, not the oldest loaded
+static void testLruEviction() {
+  Backing store(8 * PAGE);
+  PageCache cache(2, PAGE);
+  CHECK(cache.begin(store.reader(), store.bytes.size()));
+
+  uint8_t out[4];
+  cache.read(0 * PAGE, out, 4); // Load 0
+  cache.read(1 * PAGE, out, 4); // Load 1
+  cache.read(0 * PAGE, out, 4); // Hit: 1 is now least recent
+  cache.read(2 * PAGE, out, 4); // Evicts 1
+  CHECK(store.reads.size() == 3 && store.reads[2] == 2 * PAGE);
+
+  cache.read(0 * PAGE, out, 4); // Still cached
+  CHECK(store.reads.size() == 3);
+  cache.read(1 * PAGE, out, 4); // Reloaded, evicts 2
+  CHECK(store.reads.size() == 4 && store.reads[3] == 1 * PAGE);
+  CHECK(store.matches(1 * PAGE, out, 4));
+
+  const PageCacheStats &stats = cache.getStats();
+  CHECK(stats.hits == 2);
+  CHECK(stats.misses == 4);
+  CHECK(stats.evictions == 2);
+  printf("lru eviction ok\n");
+}
+
+// A region that ends mid-page: the tail page is read short, reads are
+// clipped at the limit and nothing past it is touched
+static void testTailPage() {
+  const uint32_t limit = 3 * PAGE + 5;
+  Backing store(limit);
+  PageCache cache(2, PAGE);
+  CHECK(cache.begin(store.reader(), limit));
+
+  uint8_t out[PAGE * 2];
+  CHECK(cache.read(3 * PAGE - 4, out, sizeof(out)) == 9);
+  CHECK(store.matches(3 * PAGE - 4, out, 9));
+  CHECK(store.reads.back() == 3 * PAGE);
+  CHECK(store.lens.back() == 5);
+
+  CHECK(cache.read(limit - 1, out, 4) == 1);
+  CHECK(cache.read(limit, out, 4) == 0);
+  CHECK(cache.read(limit + PAGE, out, 4) == 0);
+  CHECK(store.reads.size() == 2);
+  printf("tail page ok\n");
+}
+
+// A failed backing read ends the read short and leaves no page behind
+static void testReadFailure() {
+  Backing store(8 * PAGE);
+  PageCache cache(2, PAGE);
+  CHECK(cache.begin(store.reader(), store.bytes.size()));
+
+  uint8_t out[PAGE * 2];
+  store.failPage = 2;
+  CHECK(cache.read(PAGE + 8, out, PAGE) == 8); // Page 1 ok, page 2 fails
+  CHECK(store.matches(PAGE + 8, out, 8));
+  CHECK(cache.read(2 * PAGE, out, 4) == 0); // Not cached: read again
+  CHECK(store.reads.size() == 3);
+
+  store.failPage = -1;
+  CHECK(cache.read(2 * PAGE, out, 4) == 4);
+  CHECK(store.matches(2 * PAGE, out, 4));
+  CHECK(cache.read(PAGE, out, 4) == 4); // Page 1 survived the failures
+  CHECK(store.reads.size() == 4);
+  printf("read failure ok\n");
+}
+
+int main() {
+  testHits();
+  testLruEviction();
+  testTailPage();
+  testReadFailure();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file StaticCapacityTest.cpp
+ * @brief Host test: W4RP_STATIC_CAPACITY build
+ *
+ * Counts heap allocations (global operator new) to check that loop() never
+ * allocates once a ruleset is loaded, and checks that registrations beyond
+ * W4RP_MAX_CAPABILITIES are refused instead of silently dropped.
+ */
+
+#include "Fixtures.h"
+#include <atomic>
+#include <new>
+
+#if !W4RP_STATIC_CAPACITY
+#error "Build with W4RP_STATIC_CAPACITY=1"
+#endif
+
+static std::atomic<long> allocations{0};
+
+void *operator new(size_t n) {
+  allocations++;
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+using namespace W4RP;
+using namespace W4RP::Test;
+
+constexpr CapabilityParamDef kBlinkParams[] = {
+    {"count", ParamType::INT, true, 1, 10, "n"}};
+constexpr CapabilityDef kBlink("blink", "Blink", "", "out", kBlinkParams);
+static int blinkCount = -1;
+static void onBlink(int32_t n) { blinkCount = n; }
+
+// Signal 0x400 byte 0 > 10 -> blink(7)
+static std::vector<uint8_t> blinkRuleset() {
+  RulesetBuilder rb;
+  rb.signals.push_back({0x400, 0, 8, 0, 1.0f, 0.0f});
+  rb.conditions.push_back({0, (uint8_t)Operation::GT, 0, 10.0f, 0.0f});
+  rb.params.push_back({0, 0, 7});
+  rb.actions.push_back({rb.str("blink"), 1, 0, 0});
+  rb.rules.push_back({0, 1, 0, 1, 0, 0});
+  return rb.build();
+}
+
+static void testNoAllocationInLoop() {
+  FakeCan can;
+  MemStorage storage;
+  CachedStorage cache(&storage);
+  LoopbackTransport transport(128, 2); // No tap: it would allocate
+  Controller c(&can, &cache, &transport);
+  CHECK(c.registerCapability<kBlink>(onBlink));
+  c.begin();
+
+  // Everything the client sends is prepared up front
+  std::vector<uint8_t> ruleset = blinkRuleset();
+  std::string rules((const char *)ruleset.data(), ruleset.size());
+  std::vector<uint8_t> cmd =
+      streamCommand((uint8_t)CommandOp::SET_RULES_RAM, 1, rules);
+  uint8_t getProfile[2] = {(uint8_t)CommandOp::GET_PROFILE, 2};
+
+  long before = allocations;
+  transport.inject(cmd.data(), cmd.size());
+  c.loop();
+  transport.inject(ruleset.data(), ruleset.size());
+  c.loop();
+  transport.inject("END");
+  c.loop();
+  CHECK(c.getEngine().getRuleCount() == 1);
+  CHECK(allocations == before); // Loading a ruleset allocates nothing either
+
+  // Steady state: frames, the rule firing, a profile transfer
+  for (int k = 0; k < 2000; k++) {
+    uint8_t data[8] = {(uint8_t)(k % 40)};
+    CanFrame frame = {};
+    frame.id = 0x400;
+    memcpy(frame.data, data, 8);
+    can.rx.push_back(frame);
+    if (k == 1000)
+      transport.inject(getProfile, sizeof(getProfile));
+    long mark = allocations;
+    c.loop();
+    CHECK(allocations == mark);
+    delay(1);
+  }
+  CHECK(blinkCount == 7);
+  printf("ruleset load allocs 0, loop() allocs 0 over 2000 passes\n");
+}
+
+static void testCapabilityLimit() {
+  Engine engine;
+  auto handler = [](const ParamMap &) {};
+  char id[16];
+  for (int i = 0; i < W4RP_MAX_CAPABILITIES; i++) {
+    snprintf(id, sizeof(id), "cap%d", i);
+    CHECK(engine.registerCapability(String(id), handler, CapabilityMeta()));
+  }
+  CHECK(engine.getCapabilities().size() == W4RP_MAX_CAPABILITIES);
+
+  // Full: new IDs are refused, typed or not
+  CHECK(!engine.registerCapability(String("extra"), handler));
+  CHECK(!engine.registerCapability(kBlink, makeInvoker<kBlink>(onBlink)));
+  CHECK(engine.getCapabilities().size() == W4RP_MAX_CAPABILITIES);
+
+  // Replacing an existing one still works
+  CHECK(engine.registerCapability(String("cap0"), handler, CapabilityMeta()));
+  printf("capability limit ok (%d)\n", W4RP_MAX_CAPABILITIES);
+}
+
+int main() {
+  testNoAllocationInLoop();
+  testCapabilityLimit();
+  printf("OK\n");
+  return 0;
+}
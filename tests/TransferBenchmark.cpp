@@ -0,0 +1,81 @@
+/**
+ * @file TransferBenchmark.cpp
+ * @brief Host benchmark: bulk transfer over LoopbackTransport
+ *
+ * Sends the device profile for a set of MTUs and credits per loop().
+ * Each loop() pass stands for one 7.5 ms connection event on the
+ * simulated clock, with CAN frames arriving meanwhile. Prints link time
+ * and throughput on that clock, and the longest loop() pass in wall time.
+ * Not run by ctest:
+ *   ./TransferBenchmark
+ */
+
+#include "Fixtures.h"
+#include <chrono>
+
+using namespace W4RP;
+using namespace W4RP::Test;
+
+static const uint32_t CONN_INTERVAL_US = 7500;
+static const int CAN_FRAMES_PER_EVENT = 8;
+static const int CAPABILITIES = 32;
+
+static void run(size_t mtu, size_t credits) {
+  FakeCan can;
+  MemStorage storage;
+  LoopbackTransport transport(mtu, credits);
+  Controller c(&can, &storage, &transport);
+
+  for (int i = 0; i < CAPABILITIES; i++) {
+    CapabilityMeta meta;
+    meta.id = String(("output_" + std::to_string(i)).c_str());
+    meta.label = "Output channel";
+    meta.description = "Switches a relay output on the accessory harness";
+    meta.category = "outputs";
+    c.registerCapability(meta.id, [](const ParamMap &) {}, meta);
+  }
+  c.begin();
+  c.loop();
+  transport.resetStats();
+
+  transport.inject("GET:PROFILE");
+  uint32_t loops = 0;
+  uint32_t canLeft = 0;
+  double maxLoopUs = 0;
+  const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+  do {
+    for (int i = 0; i < CAN_FRAMES_PER_EVENT; i++)
+      can.push(0x100 + i, payload);
+
+    auto t0 = std::chrono::steady_clock::now();
+    c.loop();
+    double us = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count();
+    if (us > maxLoopUs)
+      maxLoopUs = us;
+
+    canLeft += can.rx.size();
+    loops++;
+    delayMicroseconds(CONN_INTERVAL_US);
+  } while (c.getTransferStats().active);
+
+  const TransferStats &tx = c.getTransferStats();
+  const LoopbackStats &link = transport.getStats();
+  printf("mtu %3u  credits %2u: %5u bytes %4u notifies %4u loops %6u ms "
+         "%7u B/s  max loop %6.1f us  stalls %u  CAN left %u\n",
+         (unsigned)mtu, (unsigned)credits, tx.bytes, link.packets, loops,
+         tx.durationMs, tx.throughputBps, maxLoopUs, link.creditStalls,
+         canLeft);
+}
+
+int main() {
+  const size_t mtus[] = {20, 128, 244};
+  const size_t credits[] = {1, 4, 6};
+  for (size_t mtu : mtus) {
+    for (size_t n : credits)
+      run(mtu, n);
+  }
+  return 0;
+}
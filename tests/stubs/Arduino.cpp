@@ -0,0 +1,39 @@
+/**
+ * @file Arduino.cpp
+ * @brief Host stub implementation (simulated clock, ESP helpers)
+ */
+
+#include <Arduino.h>
+#include <esp_crc.h>
+#include <esp_mac.h>
+#include <esp_system.h>
+
+HardwareSerial Serial;
+
+static uint64_t nowUs = 0;
+
+unsigned long millis() { return (unsigned long)(nowUs / 1000); }
+unsigned long micros() { return (unsigned long)nowUs; }
+void delay(uint32_t ms) { nowUs += (uint64_t)ms * 1000; }
+void delayMicroseconds(uint32_t us) { nowUs += us; }
+
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+int esp_read_mac(uint8_t *mac, int) {
+  for (int i = 0; i < 6; i++)
+    mac[i] = (uint8_t)i;
+  return 0;
+}
+
+void esp_restart() {}
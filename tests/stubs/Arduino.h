@@ -0,0 +1,74 @@
+/**
+ * @file Arduino.h
+ * @brief Host stub: the parts of the Arduino core the library uses
+ *
+ * String is backed by std::string. Time is simulated: millis() and
+ * micros() only advance through delay() / delayMicroseconds(), so tests
+ * control every interval exactly.
+ */
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const char *s, size_t n) : s_(s, n) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+
+  const char *c_str() const { return s_.c_str(); }
+  size_t length() const { return s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = (a == std::string::npos) ? "" : s_.substr(a, b - a + 1);
+  }
+  bool startsWith(const char *p) const { return s_.rfind(p, 0) == 0; }
+  int indexOf(char c, int from = 0) const {
+    size_t p = s_.find(c, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  String substring(int from, int to = -1) const {
+    return String(s_.substr(from, to < 0 ? std::string::npos : to - from)
+                      .c_str());
+  }
+  long toInt() const { return atol(s_.c_str()); }
+  float toFloat() const { return (float)atof(s_.c_str()); }
+
+  bool operator==(const char *o) const { return s_ == o; }
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator<(const String &o) const { return s_ < o.s_; }
+
+private:
+  std::string s_;
+};
+
+/// Serial output is discarded
+struct HardwareSerial {
+  void begin(unsigned long) {}
+  int printf(const char *, ...) { return 0; }
+  void print(const char *) {}
+  void println(const char *) {}
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
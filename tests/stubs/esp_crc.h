@@ -0,0 +1,5 @@
+/** @file esp_crc.h @brief Host stub */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
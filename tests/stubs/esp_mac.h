@@ -0,0 +1,5 @@
+/** @file esp_mac.h @brief Host stub */
+#pragma once
+#include <cstdint>
+#define ESP_MAC_BT 2
+int esp_read_mac(uint8_t *mac, int type);
@@ -0,0 +1,3 @@
+/** @file esp_system.h @brief Host stub */
+#pragma once
+void esp_restart();
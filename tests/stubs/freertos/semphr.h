@@ -0,0 +1,2 @@
+/** @file semphr.h @brief Host stub (nothing used by the host build) */
+#pragma once